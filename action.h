@@ -0,0 +1,119 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+#ifndef PETRINET_ACTION_H
+#define PETRINET_ACTION_H
+
+#include <cassert>
+#include <tuple>
+#include <type_traits>
+
+namespace petrinet
+{
+
+  class Token;
+
+  // Action of a transition created with createTypedTransition. The fires
+  // carry their arguments in the tuple the action expects and a token of its
+  // type, the net made sure of that when the fire was queued.
+  class TransitionAction
+  {
+  public:
+    virtual ~TransitionAction() {}
+
+    // Arguments is the tuple of the fire, null if the action takes none
+    virtual void invoke(Token* token, const void* arguments) const = 0;
+    virtual int arity() const = 0;
+    // Whether the token is of the type the action is a member of
+    virtual bool accepts(Token* token) const = 0;
+  };
+
+  // Compile time list of tuple indices
+  template<int... I>
+  struct Indices {};
+
+  template<int N, int... I>
+  struct MakeIndices : MakeIndices<N - 1, N - 1, I...> {};
+
+  template<int... I>
+  struct MakeIndices<0, I...>
+  {
+    typedef Indices<I...> type;
+  };
+
+  // Arguments are stored by value, the member function gets const references
+  // to them
+  template<typename... Args>
+  struct ActionArguments
+  {
+    typedef std::tuple<typename std::decay<Args>::type...> type;
+  };
+
+  template<class T, typename... Args>
+  class MemberAction : public TransitionAction
+  {
+  public:
+    typedef typename ActionArguments<Args...>::type Arguments;
+
+    explicit MemberAction(void (T::* func)(Args...)) : func_(func) {}
+
+    virtual void invoke(Token* token, const void* arguments) const
+    {
+      assert(arguments || sizeof...(Args) == 0);
+      call(static_cast<T*>(token), static_cast<const Arguments*>(arguments), typename MakeIndices<sizeof...(Args)>::type());
+    }
+
+    virtual int arity() const { return sizeof...(Args); }
+
+    virtual bool accepts(Token* token) const { return dynamic_cast<T*>(token) != nullptr; }
+
+  private:
+    template<int... I>
+    void call(T* token, const Arguments* arguments, Indices<I...>) const
+    {
+      // Unused without arguments
+      (void) arguments;
+      (token->*func_)(std::get<I>(*arguments)...);
+    }
+
+    void (T::* func_)(Args...);
+  };
+
+  // Returned by createTypedTransition, queueing a fire through it checks the
+  // arguments at compile time
+  template<class T, typename... Args>
+  class TypedTransition
+  {
+  public:
+    typedef typename ActionArguments<Args...>::type Arguments;
+
+    explicit TypedTransition(int id) : id_(id) {}
+
+    int id() const { return id_; }
+
+  private:
+    int id_;
+  };
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,114 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+#include "actionpool.h"
+#include "token.h"
+
+using namespace petrinet;
+
+ActionPool::ActionPool(int threads)
+  : workers_(threads),
+  running_(0)
+{
+  // More strands than threads, unrelated tokens rarely share one
+  for(int i = 0; i < threads * 16; ++i)
+    strands_.push_back(std::unique_ptr<boost::asio::io_service::strand>(new boost::asio::io_service::strand(workers_.get())));
+}
+
+ActionPool::~ActionPool()
+{
+  // Exceptions not taken by a wait are dropped
+  std::unique_lock<std::mutex> lk(mutex_);
+  cv_.wait(lk, [this]{ return running_ == 0; });
+}
+
+void ActionPool::execute(const std::function<void(Token*, boost::any, boost::any, boost::any)>& func, const Fire& f)
+{
+  // The copied fire keeps the token alive until the action ran
+  started(f).post([this, func, f]
+  {
+    // A throwing action must not stall its strand or the waiters
+    try
+    {
+      func(f.token().get(), f.a(), f.b(), f.c());
+    }
+    catch(...)
+    {
+      failed(std::current_exception());
+    }
+    finished();
+  });
+}
+
+void ActionPool::execute(const std::shared_ptr<const TransitionAction>& action, const Fire& f)
+{
+  started(f).post([this, action, f]
+  {
+    try
+    {
+      action->invoke(f.token().get(), f.typedArguments());
+    }
+    catch(...)
+    {
+      failed(std::current_exception());
+    }
+    finished();
+  });
+}
+
+boost::asio::io_service::strand& ActionPool::started(const Fire& f)
+{
+  {
+    std::unique_lock<std::mutex> lk(mutex_);
+    ++running_;
+  }
+
+  // Pointers are aligned, an identity hash would only use a few strands
+  return *strands_[hashPointer(f.token().get()) % strands_.size()];
+}
+
+void ActionPool::wait()
+{
+  std::unique_lock<std::mutex> lk(mutex_);
+  cv_.wait(lk, [this]{ return running_ == 0; });
+
+  std::exception_ptr error;
+  error.swap(error_);
+  lk.unlock();
+  if(error)
+    std::rethrow_exception(error);
+}
+
+void ActionPool::failed(std::exception_ptr error)
+{
+  std::unique_lock<std::mutex> lk(mutex_);
+  if(!error_)
+    error_ = error;
+}
+
+void ActionPool::finished()
+{
+  std::unique_lock<std::mutex> lk(mutex_);
+  if(--running_ == 0)
+    cv_.notify_all();
+}
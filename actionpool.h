@@ -0,0 +1,78 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+#ifndef PETRINET_ACTIONPOOL_H
+#define PETRINET_ACTIONPOOL_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <boost/any.hpp>
+#include <boost/asio.hpp>
+
+#include "action.h"
+#include "fire.h"
+#include "workerpool.h"
+
+namespace petrinet
+{
+
+  class Token;
+
+  // Runs transition actions away from the thread moving the tokens. Actions
+  // on the same token run one after the other in the order they were
+  // executed, a token always maps to the same strand.
+  class ActionPool
+  {
+  public:
+    ActionPool(int threads);
+    ~ActionPool();
+
+    void execute(const std::function<void(Token*, boost::any, boost::any, boost::any)>& func, const Fire& f);
+    void execute(const std::shared_ptr<const TransitionAction>& action, const Fire& f);
+
+    // Returns when all executed actions finished. Rethrows the first
+    // exception an action threw since the last wait, the actions after it
+    // still ran.
+    void wait();
+
+  private:
+    boost::asio::io_service::strand& started(const Fire& f);
+    void failed(std::exception_ptr error);
+    void finished();
+
+    WorkerPool workers_;
+    std::vector<std::unique_ptr<boost::asio::io_service::strand>> strands_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    int running_;
+    std::exception_ptr error_;
+  };
+}
+
+#endif
\ No newline at end of file
@@ -27,44 +27,38 @@
 using namespace petrinet;
 
 Fire::Fire()
+  : transitionId_(-1),
+  priority_(0)
 {
 }
 
 Fire::Fire(int transitionId, SharedTreePointer<Token> token, boost::any a, boost::any b, boost::any c)
-  : data_(new FireData())
+  : token_(std::move(token)),
+  transitionId_(transitionId),
+  priority_(0)
 {
-  data_->transitionId_ = transitionId;
-  data_->token_ = token;
-  data_->a_ = a;
-  data_->b_ = b;
-  data_->c_ = c;
+  if(!a.empty() || !b.empty() || !c.empty())
+    arguments_ = std::make_shared<FireArguments>(FireArguments{a, b, c});
 }
 
-
-Fire::~Fire()
+Fire::Fire(int transitionId, SharedTreePointer<Token> token, std::shared_ptr<const void> arguments)
+  : token_(std::move(token)),
+  transitionId_(transitionId),
+  priority_(0),
+  typedArguments_(arguments)
 {
 }
 
 bool Fire::operator==(const Fire& f) const
 {
-  return f.data_->token_ == data_->token_ && f.data_->transitionId_ == data_->transitionId_;
-}
-
-SharedTreePointer<Token> Fire::token() const
-{
-  return data_->token_;
-}
-
-int Fire::transitionId() const
-{
-  return data_->transitionId_;
+  return f.token_ == token_ && f.transitionId_ == transitionId_;
 }
 
 std::string Fire::toString() const
 {
   return std::string("Fire(") 
          + std::string("T") + std::to_string(transitionId()) + ", "
-         + token().get()->toString()
+         + (token().get() ? token().get()->toString() : std::string("no token"))
          + ")";
 }
 
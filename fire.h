@@ -24,45 +24,60 @@
 #ifndef PETRINET_FIRE_H
 #define PETRINET_FIRE_H
 
+#include <chrono>
+#include <memory>
+
 #include <boost/any.hpp>
 #include "sharedtreepointer.h"
+#include "token.h"
 
 namespace petrinet
 {
 
-  class Token;
-
-  struct FireData
+  // Arguments of the action, shared by the copies of a fire
+  struct FireArguments
   {
     boost::any a_;
     boost::any b_;
     boost::any c_;
-    SharedTreePointer<Token> token_;
-    int transitionId_;
   };
 
+  // Copied by value through the queues. Only a fire with arguments allocates,
+  // once, for the arguments. A boost::any keeps its value on the heap anyway,
+  // so the arguments are shared by the copies rather than stored inline.
   class Fire
   {
   public:
     Fire();
     Fire(int transitionId, SharedTreePointer<Token> token, boost::any a = boost::any(), boost::any b = boost::any(), boost::any c = boost::any());
-    virtual ~Fire();
+    // Fire of a typed transition, arguments is the tuple its action expects
+    Fire(int transitionId, SharedTreePointer<Token> token, std::shared_ptr<const void> arguments);
 
     bool operator==(const Fire& f) const;
 
-    SharedTreePointer<Token> token() const;
-    int transitionId() const;
+    const SharedTreePointer<Token>& token() const { return token_; }
+    int transitionId() const { return transitionId_; }
 
-    boost::any a() const { return data_->a_; }
-    boost::any b() const { return data_->b_; }
-    boost::any c() const { return data_->c_; }
+    boost::any a() const { return arguments_ ? arguments_->a_ : boost::any(); }
+    boost::any b() const { return arguments_ ? arguments_->b_ : boost::any(); }
+    boost::any c() const { return arguments_ ? arguments_->c_ : boost::any(); }
+    const void* typedArguments() const { return typedArguments_.get(); }
+
+    // Used by the scheduling of queued fires, see Scheduling
+    int priority() const { return priority_; }
+    void setPriority(int priority) { priority_ = priority; }
+    std::chrono::steady_clock::time_point deadline() const { return deadline_; }
+    void setDeadline(std::chrono::steady_clock::time_point deadline) { deadline_ = deadline; }
 
     std::string toString() const;
 
   private:
-    std::shared_ptr<FireData> data_;
-
-  
+    SharedTreePointer<Token> token_;
+    int transitionId_;
+    int priority_;
+    std::chrono::steady_clock::time_point deadline_;
+    std::shared_ptr<const FireArguments> arguments_;
+    std::shared_ptr<const void> typedArguments_;
   };
 
 }
@@ -74,10 +89,7 @@ namespace std
   {
     std::size_t operator()(const petrinet::Fire& s) const
     {
-      intmax_t h = (intmax_t)s.token().get();
-      h = h << 8;
-      h += s.transitionId();
-      return h * 2654435761 % (long)std::pow(2.0, 32.0);
+      return petrinet::hashPointer(s.token().get()) ^ (std::size_t) s.transitionId() * 2654435761u;
     }
   };
 };
@@ -0,0 +1,90 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+#ifndef PETRINET_FIREPLAN_H
+#define PETRINET_FIREPLAN_H
+
+#include <utility>
+#include <vector>
+
+#include "sharedtreepointer.h"
+#include "token.h"
+
+namespace petrinet
+{
+
+  // What a fire of a transition moves, resolved once against the levels of
+  // its places. canFire checks the plan and fire carries it out, a queued
+  // fire keeps its plan for its next attempt. The steps only depend on the
+  // transition, a plan reused for the same transition only resolves the
+  // tokens again.
+  struct FirePlan
+  {
+    // Tokens of the fire at one level of its tree
+    struct Level
+    {
+      int level;
+      int first;
+      int size;
+    };
+
+    // Arc of the transition: weight copies of each token at the level of the
+    // place. A counter place only takes or puts the weight.
+    struct Step
+    {
+      int place;
+      int weight;
+      // Index in levels, -1 for a counter place
+      int level;
+    };
+
+    FirePlan() : transition(-1), resolved(false) {}
+
+    // Tokens the step takes from or puts in its place
+    int amount(const Step& step) const { return step.level == -1 ? step.weight : levels[step.level].size * step.weight; }
+    const SharedTreePointer<Token>* begin(const Step& step) const { return tokens.data() + levels[step.level].first; }
+    const SharedTreePointer<Token>* end(const Step& step) const { return begin(step) + levels[step.level].size; }
+
+    // Lets go of the tokens, the steps and the capacity stay
+    void release() { tokens.clear(); resolved = false; }
+
+    void swap(FirePlan& other)
+    {
+      std::swap(transition, other.transition);
+      std::swap(resolved, other.resolved);
+      inputs.swap(other.inputs);
+      outputs.swap(other.outputs);
+      levels.swap(other.levels);
+      tokens.swap(other.tokens);
+    }
+
+    int transition;
+    bool resolved;
+    std::vector<Step> inputs;
+    std::vector<Step> outputs;
+    std::vector<Level> levels;
+    std::vector<SharedTreePointer<Token>> tokens;
+  };
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,212 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+#ifndef PETRINET_FLATMAP_H
+#define PETRINET_FLATMAP_H
+
+#include <cassert>
+#include <utility>
+#include <vector>
+
+namespace petrinet
+{
+
+  // Hash map with open addressing and linear probing, for small keys and
+  // values that are cheap to move. Slots holding the empty key are free.
+  // Erasing shifts the rest of the probe sequence back instead of leaving a
+  // tombstone, so the table only allocates when it grows.
+  template<class K, class V, class Hash>
+  class FlatMap
+  {
+  public:
+    // Visits the entries in table order
+    class const_iterator
+    {
+      friend class FlatMap;
+      public:
+        const_iterator& operator++() { ++slot_; skipEmpty(); return *this; }
+        const std::pair<K, V>& operator*() const { return *slot_; }
+        const std::pair<K, V>* operator->() const { return slot_; }
+        bool operator==(const const_iterator& other) const { return slot_ == other.slot_; }
+        bool operator!=(const const_iterator& other) const { return slot_ != other.slot_; }
+
+      private:
+        const_iterator(const FlatMap* map, const std::pair<K, V>* slot) : map_(map), slot_(slot) { skipEmpty(); }
+        void skipEmpty()
+        {
+          const std::pair<K, V>* end = map_->slots_.data() + map_->slots_.size();
+          while(slot_ != end && slot_->first == map_->empty_)
+            ++slot_;
+        }
+
+        const FlatMap* map_;
+        const std::pair<K, V>* slot_;
+    };
+
+    explicit FlatMap(const K& empty);
+
+    int size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    // Null if the key is not in the map
+    V* find(const K& key);
+    const V* find(const K& key) const;
+
+    // The value of the key, inserted when missing
+    std::pair<V*, bool> insert(const K& key, const V& value);
+    bool erase(const K& key);
+
+    void reserve(int size);
+    // Keeps the table
+    void clear();
+
+    const_iterator begin() const { return const_iterator(this, slots_.data()); }
+    const_iterator end() const { return const_iterator(this, slots_.data() + slots_.size()); }
+
+  private:
+    int slotOf(const K& key) const;
+    void rehash(int slots);
+
+    // Power of two, at most half used
+    std::vector<std::pair<K, V>> slots_;
+    K empty_;
+    int size_;
+    Hash hash_;
+  };
+
+  template<class K, class V, class Hash>
+  FlatMap<K, V, Hash>::FlatMap(const K& empty)
+    : empty_(empty),
+    size_(0)
+  {
+  }
+
+  template<class K, class V, class Hash>
+  V* FlatMap<K, V, Hash>::find(const K& key)
+  {
+    int i = slotOf(key);
+    return i == -1 || slots_[i].first == empty_ ? nullptr : &slots_[i].second;
+  }
+
+  template<class K, class V, class Hash>
+  const V* FlatMap<K, V, Hash>::find(const K& key) const
+  {
+    int i = slotOf(key);
+    return i == -1 || slots_[i].first == empty_ ? nullptr : &slots_[i].second;
+  }
+
+  template<class K, class V, class Hash>
+  std::pair<V*, bool> FlatMap<K, V, Hash>::insert(const K& key, const V& value)
+  {
+    assert(!(key == empty_));
+    if(2 * (size_ + 1) > (int)slots_.size())
+      rehash(slots_.empty() ? 8 : 2 * slots_.size());
+
+    std::pair<K, V>& slot = slots_[slotOf(key)];
+    if(slot.first == key)
+      return std::pair<V*, bool>(&slot.second, false);
+
+    slot.first = key;
+    slot.second = value;
+    ++size_;
+    return std::pair<V*, bool>(&slot.second, true);
+  }
+
+  template<class K, class V, class Hash>
+  bool FlatMap<K, V, Hash>::erase(const K& key)
+  {
+    int i = slotOf(key);
+    if(i == -1 || slots_[i].first == empty_)
+      return false;
+
+    // Move later entries of the probe sequence into the hole when their home
+    // slot does not lie between the hole and themselves
+    --size_;
+    int mask = slots_.size() - 1;
+    int hole = i;
+    for(int j = (i + 1) & mask; !(slots_[j].first == empty_); j = (j + 1) & mask)
+    {
+      int home = hash_(slots_[j].first) & mask;
+      if(((j - home) & mask) >= ((j - hole) & mask))
+      {
+        slots_[hole] = std::move(slots_[j]);
+        hole = j;
+      }
+    }
+    slots_[hole] = std::pair<K, V>(empty_, V());
+    return true;
+  }
+
+  template<class K, class V, class Hash>
+  void FlatMap<K, V, Hash>::reserve(int size)
+  {
+    int slots = 8;
+    while(slots < 2 * size)
+      slots *= 2;
+    if(slots > (int)slots_.size())
+      rehash(slots);
+  }
+
+  template<class K, class V, class Hash>
+  void FlatMap<K, V, Hash>::clear()
+  {
+    for(auto it = slots_.begin(); it != slots_.end(); ++it)
+      *it = std::pair<K, V>(empty_, V());
+    size_ = 0;
+  }
+
+  template<class K, class V, class Hash>
+  int FlatMap<K, V, Hash>::slotOf(const K& key) const
+  {
+    // The slot of the key, or the free slot ending its probe sequence
+    if(slots_.empty())
+      return -1;
+
+    int mask = slots_.size() - 1;
+    int i = hash_(key) & mask;
+    while(!(slots_[i].first == key) && !(slots_[i].first == empty_))
+      i = (i + 1) & mask;
+    return i;
+  }
+
+  template<class K, class V, class Hash>
+  void FlatMap<K, V, Hash>::rehash(int slots)
+  {
+    std::vector<std::pair<K, V>> old(slots, std::pair<K, V>(empty_, V()));
+    old.swap(slots_);
+
+    int mask = slots - 1;
+    for(auto it = old.begin(); it != old.end(); ++it)
+    {
+      if(it->first == empty_)
+        continue;
+
+      int i = hash_(it->first) & mask;
+      while(!(slots_[i].first == empty_))
+        i = (i + 1) & mask;
+      slots_[i] = std::move(*it);
+    }
+  }
+}
+
+#endif
\ No newline at end of file
@@ -50,7 +50,8 @@ std::string LogItem::getMessage() const
 
 
 Logger::Logger(LogControl* logControl)
-  : loggerData_(new LoggerData())
+  : loggerData_(new LoggerData()),
+  enabled_(true)
 {
   loggerData_->logControl_ = logControl;
   loggerData_->postActive_ = false;
@@ -78,11 +79,9 @@ void Logger::log(std::function<std::string(void)> message)
 
   loggerData_->queue_.push(new LogItem(item));
   
-  if(!loggerData_->postActive_)
-  {
-    loggerData_->postActive_ = true;
+  // Several threads may log at once, only one of them posts the handler
+  if(!loggerData_->postActive_.exchange(true))
     ioService_.get().post(std::bind(&Logger::handleLog, loggerData_));
-  }
 }
 
 void Logger::handleLog(std::shared_ptr<LoggerData> loggerData)
@@ -78,7 +78,7 @@ namespace petrinet
     ~LoggerData() { delete logControl_; }
     boost::lockfree::queue<LogItem*> queue_;
     LogControl* logControl_;
-    bool postActive_;
+    boost::atomic<bool> postActive_;
   };
 
   class Logger
@@ -91,12 +91,17 @@ namespace petrinet
       void log(std::string message);
       void log(std::function<std::string(void)> message);
 
+      // Callers skip building their messages while disabled
+      bool enabled() const { return enabled_; }
+      void setEnabled(bool enabled) { enabled_ = enabled; }
+
       static EventLoop& ioService();
 
     private:
       static void handleLog(std::shared_ptr<LoggerData> loggerData);
 
       std::shared_ptr<LoggerData> loggerData_;
+      bool enabled_;
       static EventLoop ioService_;
   };
 }
@@ -0,0 +1,102 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+#include <cassert>
+
+#include "marking.h"
+
+using namespace petrinet;
+
+Marking::iterator::iterator(const Table::const_iterator& slot)
+  : slot_(slot),
+  repeat_(0)
+{
+}
+
+Marking::iterator& Marking::iterator::operator++()
+{
+  if(++repeat_ == slot_->second.count)
+  {
+    repeat_ = 0;
+    ++slot_;
+  }
+  return *this;
+}
+
+Marking::Marking()
+  : tokens_(nullptr),
+  size_(0)
+{
+}
+
+int Marking::count(const Token* token) const
+{
+  const Slot* slot = tokens_.find(token);
+  return slot ? slot->count : 0;
+}
+
+int Marking::insert(const SharedTreePointer<Token>& token, int amount)
+{
+  assert(token.get() && amount > 0);
+
+  // Only a new token is copied into the table
+  size_ += amount;
+  Slot* slot = tokens_.find(token.get());
+  if(!slot)
+    slot = tokens_.insert(token.get(), Slot{token, 0}).first;
+  return slot->count += amount;
+}
+
+int Marking::erase(const SharedTreePointer<Token>& token, int amount)
+{
+  Slot* slot = tokens_.find(token.get());
+  assert(slot && slot->count >= amount);
+
+  size_ -= amount;
+  if(slot->count -= amount)
+    return slot->count;
+
+  tokens_.erase(token.get());
+  return 0;
+}
+
+void Marking::reserve(int distinct)
+{
+  tokens_.reserve(distinct);
+}
+
+void Marking::clear()
+{
+  tokens_.clear();
+  size_ = 0;
+}
+
+Marking::iterator Marking::begin() const
+{
+  return iterator(tokens_.begin());
+}
+
+Marking::iterator Marking::end() const
+{
+  return iterator(tokens_.end());
+}
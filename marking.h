@@ -0,0 +1,99 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+#ifndef PETRINET_MARKING_H
+#define PETRINET_MARKING_H
+
+#include <iterator>
+#include <vector>
+
+#include "flatmap.h"
+#include "sharedtreepointer.h"
+#include "token.h"
+
+namespace petrinet
+{
+
+  // Tokens of a place with their multiplicity. A token is stored once, in a
+  // flat open addressing table, however often it is present, so counting it
+  // is O(1). Iterating visits a token as often as it is present.
+  class Marking
+  {
+    struct Slot
+    {
+      SharedTreePointer<Token> token;
+      int count;
+    };
+
+    typedef FlatMap<const Token*, Slot, PointerHash> Table;
+
+  public:
+    class iterator : public std::iterator<std::forward_iterator_tag, const SharedTreePointer<Token>>
+    {
+      friend class Marking;
+      public:
+        iterator& operator++();
+        const SharedTreePointer<Token>& operator*() const { return slot_->second.token; }
+        const SharedTreePointer<Token>* operator->() const { return &slot_->second.token; }
+        bool operator==(const iterator& other) const { return slot_ == other.slot_ && repeat_ == other.repeat_; }
+        bool operator!=(const iterator& other) const { return !(*this == other); }
+
+      private:
+        iterator(const Table::const_iterator& slot);
+        Table::const_iterator slot_;
+        int repeat_;
+    };
+
+    Marking();
+
+    // Tokens including their multiplicity
+    int size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    // Different tokens
+    int distinct() const { return tokens_.size(); }
+
+    int count(const SharedTreePointer<Token>& token) const { return count(token.get()); }
+    int count(const Token* token) const;
+
+    // Both return the count of the token afterwards, any amount costs the same
+    int insert(const SharedTreePointer<Token>& token, int amount = 1);
+    int erase(const SharedTreePointer<Token>& token, int amount = 1);
+
+    void reserve(int distinct);
+    // Keeps the table
+    void clear();
+
+    iterator begin() const;
+    iterator end() const;
+
+  private:
+    // Keyed by the token, empty slots have a null key
+    Table tokens_;
+    int size_;
+  };
+
+  inline Marking::iterator begin(const Marking& marking) { return marking.begin(); }
+  inline Marking::iterator end(const Marking& marking) { return marking.end(); }
+}
+
+#endif
\ No newline at end of file
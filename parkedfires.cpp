@@ -0,0 +1,232 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+#include <cassert>
+
+#include "parkedfires.h"
+
+using namespace petrinet;
+
+ParkedFires::ParkedFires()
+  : scheduling_(Scheduling::Fifo),
+  sequence_(0),
+  first_(nullptr),
+  last_(nullptr),
+  size_(0),
+  byToken_(nullptr)
+{
+}
+
+void ParkedFires::setScheduling(Scheduling scheduling)
+{
+  assert(empty());
+  scheduling_ = scheduling;
+}
+
+void ParkedFires::reserve(int size)
+{
+  byToken_.reserve(size);
+  blocked_.reserve(size);
+  if(scheduling_ != Scheduling::Fifo)
+    heap_.reserve(size);
+}
+
+ParkedFires::Entry* ParkedFires::insert(const Fire& f, int slot)
+{
+  long long key = 0;
+  if(scheduling_ == Scheduling::Priority)
+    key = -f.priority();
+  else if(scheduling_ == Scheduling::EarliestDeadline)
+    key = f.deadline().time_since_epoch().count();
+
+  Entry* entry;
+  if(free_.empty())
+  {
+    pool_.push_back(Entry());
+    entry = &pool_.back();
+  }
+  else
+  {
+    entry = free_.back();
+    free_.pop_back();
+  }
+
+  entry->fire = f;
+  entry->key = key;
+  entry->sequence = sequence_++;
+  entry->heapIndex = -1;
+  entry->blockedIndex = -1;
+  entry->slot = slot;
+
+  entry->previous = last_;
+  entry->next = nullptr;
+  if(last_)
+    last_->next = entry;
+  else
+    first_ = entry;
+  last_ = entry;
+  ++size_;
+
+  // The null token is the empty key of the index
+  entry->previousForToken = nullptr;
+  entry->nextForToken = nullptr;
+  if(f.token().get())
+  {
+    std::pair<Entry**, bool> head = byToken_.insert(f.token().get(), entry);
+    if(!head.second)
+    {
+      entry->nextForToken = *head.first;
+      (*head.first)->previousForToken = entry;
+      *head.first = entry;
+    }
+  }
+
+  if(scheduling_ != Scheduling::Fifo)
+    push(heap_, &Entry::heapIndex, entry);
+  return entry;
+}
+
+ParkedFires::Entry* ParkedFires::find(Token* token)
+{
+  if(!token)
+    return nullptr;
+
+  // Usually a single fire per token
+  Entry* const* head = byToken_.find(token);
+  if(!head)
+    return nullptr;
+
+  Entry* best = *head;
+  for(Entry* entry = best->nextForToken; entry; entry = entry->nextForToken)
+  {
+    if(before(entry, best))
+      best = entry;
+  }
+  return best;
+}
+
+void ParkedFires::erase(Entry* entry)
+{
+  if(entry->previousForToken)
+    entry->previousForToken->nextForToken = entry->nextForToken;
+  else if(entry->nextForToken)
+    *byToken_.find(entry->fire.token().get()) = entry->nextForToken;
+  else if(entry->fire.token().get())
+    byToken_.erase(entry->fire.token().get());
+  if(entry->nextForToken)
+    entry->nextForToken->previousForToken = entry->previousForToken;
+
+  if(entry->previous)
+    entry->previous->next = entry->next;
+  else
+    first_ = entry->next;
+  if(entry->next)
+    entry->next->previous = entry->previous;
+  else
+    last_ = entry->previous;
+  --size_;
+
+  if(scheduling_ != Scheduling::Fifo)
+    remove(heap_, &Entry::heapIndex, entry);
+  unblock(entry);
+
+  // Drops the token, the entry waits for reuse
+  entry->fire = Fire();
+  entry->plan.release();
+  free_.push_back(entry);
+}
+
+void ParkedFires::block(Entry* entry)
+{
+  if(entry->blockedIndex == -1)
+    push(blocked_, &Entry::blockedIndex, entry);
+}
+
+void ParkedFires::unblock(Entry* entry)
+{
+  if(entry->blockedIndex != -1)
+  {
+    remove(blocked_, &Entry::blockedIndex, entry);
+    entry->blockedIndex = -1;
+  }
+}
+
+bool ParkedFires::before(const Entry* l, const Entry* r) const
+{
+  return l->key < r->key || (l->key == r->key && l->sequence < r->sequence);
+}
+
+void ParkedFires::push(std::vector<Entry*>& heap, HeapIndex index, Entry* entry)
+{
+  heap.push_back(entry);
+  entry->*index = heap.size() - 1;
+  siftUp(heap, index, entry->*index);
+}
+
+void ParkedFires::remove(std::vector<Entry*>& heap, HeapIndex index, Entry* entry)
+{
+  int i = entry->*index;
+  Entry* last = heap.back();
+  heap.pop_back();
+  if(last != entry)
+  {
+    heap[i] = last;
+    last->*index = i;
+    siftUp(heap, index, i);
+    siftDown(heap, index, last->*index);
+  }
+}
+
+void ParkedFires::siftUp(std::vector<Entry*>& heap, HeapIndex index, int i)
+{
+  Entry* entry = heap[i];
+  while(i > 0 && before(entry, heap[(i - 1) / 2]))
+  {
+    heap[i] = heap[(i - 1) / 2];
+    heap[i]->*index = i;
+    i = (i - 1) / 2;
+  }
+  heap[i] = entry;
+  entry->*index = i;
+}
+
+void ParkedFires::siftDown(std::vector<Entry*>& heap, HeapIndex index, int i)
+{
+  Entry* entry = heap[i];
+  const int size = heap.size();
+  for(;;)
+  {
+    int child = 2 * i + 1;
+    if(child >= size)
+      break;
+    if(child + 1 < size && before(heap[child + 1], heap[child]))
+      ++child;
+    if(!before(heap[child], entry))
+      break;
+    heap[i] = heap[child];
+    heap[i]->*index = i;
+    i = child;
+  }
+  heap[i] = entry;
+  entry->*index = i;
+}
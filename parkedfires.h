@@ -0,0 +1,133 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+#ifndef PETRINET_PARKEDFIRES_H
+#define PETRINET_PARKEDFIRES_H
+
+#include <deque>
+#include <vector>
+
+#include "fire.h"
+#include "fireplan.h"
+#include "flatmap.h"
+
+namespace petrinet
+{
+
+  class Token;
+
+  // Which of the queued fires of a transition goes first
+  enum class Scheduling
+  {
+    // In the order they were queued
+    Fifo,
+    // Highest Fire::priority first, in queue order among equals
+    Priority,
+    // Earliest Fire::deadline first, in queue order among equals
+    EarliestDeadline
+  };
+
+  // Queued fires of one transition. Fires are found by token, or the next
+  // one by the scheduling policy: the head of the queue order for FIFO, the
+  // top of an indexed heap otherwise. Fires with their tokens in place that
+  // only lack anonymous tokens or capacity are blocked, a second heap orders
+  // them. Entries are pooled and linked in place, once the pool has grown
+  // queueing a fire does not allocate.
+  class ParkedFires
+  {
+  public:
+    struct Entry
+    {
+      Fire fire;
+      // Resolved on the first attempt to fire
+      FirePlan plan;
+      long long key;
+      unsigned long long sequence;
+      int heapIndex;
+      // Position among the blocked fires, -1 if not blocked
+      int blockedIndex;
+      // Handle slot of the fire
+      int slot;
+      // Queue order, and the other fires for the same token
+      Entry* previous;
+      Entry* next;
+      Entry* previousForToken;
+      Entry* nextForToken;
+      // Fires for the same token of the other transitions in the conflict
+      // component, chained by the net
+      Entry* previousInComponent;
+      Entry* nextInComponent;
+    };
+
+    ParkedFires();
+
+    void setScheduling(Scheduling scheduling);
+    void reserve(int size);
+
+    bool empty() const { return size_ == 0; }
+    int size() const { return size_; }
+
+    Entry* insert(const Fire& f, int slot);
+
+    // Next fire for the token, null if there is none. Tokenless fires are
+    // only found as blocked fires, the token index leaves them out.
+    Entry* find(Token* token);
+    bool contains(Token* token) const { return token && byToken_.find(token); }
+    // First queued, regardless of the scheduling. Follow next for the others
+    // in queue order.
+    Entry* oldest() { return first_; }
+    const Entry* oldest() const { return first_; }
+    void erase(Entry* entry);
+
+    // Next blocked fire by the scheduling, null if there is none
+    Entry* firstBlocked() const { return blocked_.empty() ? nullptr : blocked_.front(); }
+    void block(Entry* entry);
+    void unblock(Entry* entry);
+
+  private:
+    typedef int Entry::* HeapIndex;
+
+    bool before(const Entry* l, const Entry* r) const;
+    void push(std::vector<Entry*>& heap, HeapIndex index, Entry* entry);
+    void remove(std::vector<Entry*>& heap, HeapIndex index, Entry* entry);
+    void siftUp(std::vector<Entry*>& heap, HeapIndex index, int i);
+    void siftDown(std::vector<Entry*>& heap, HeapIndex index, int i);
+
+    Scheduling scheduling_;
+    unsigned long long sequence_;
+
+    // The deque never moves the entries, erased ones are reused
+    std::deque<Entry> pool_;
+    std::vector<Entry*> free_;
+    Entry* first_;
+    Entry* last_;
+    int size_;
+
+    // Latest fire queued for each token, the others are chained to it
+    FlatMap<Token*, Entry*, PointerHash> byToken_;
+    std::vector<Entry*> heap_;
+    std::vector<Entry*> blocked_;
+  };
+}
+
+#endif
\ No newline at end of file
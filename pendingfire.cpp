@@ -0,0 +1,93 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+#include <cassert>
+
+#include "pendingfire.h"
+
+using namespace petrinet;
+
+PendingFire::PendingFire(int transition, const Fire& f, RingBuffer<PendingFire*>* readyFires)
+  : slot_(-1),
+  previousInComponent_(nullptr),
+  nextInComponent_(nullptr),
+  transition_(transition),
+  fire_(f),
+  missingInputs_(0),
+  queued_(false),
+  discarded_(false),
+  waitingPlace_(-1),
+  wokenBy_(-1),
+  readyFires_(readyFires)
+{
+}
+
+void PendingFire::addDependency(int place, Token* token, int amount, bool present)
+{
+  dependencies_.push_back(FireDependency{this, place, token, amount});
+
+  if(!present)
+    ++missingInputs_;
+}
+
+void PendingFire::inputSatisfied()
+{
+  assert(missingInputs_ > 0);
+  --missingInputs_;
+  checkReady();
+}
+
+void PendingFire::inputMissing()
+{
+  ++missingInputs_;
+}
+
+bool PendingFire::capacityAvailable()
+{
+  int place = waitingPlace_;
+  waitingPlace_ = -1;
+  if(!ready())
+    return false;
+
+  wokenBy_ = place;
+  checkReady();
+  return true;
+}
+
+int PendingFire::dequeued()
+{
+  queued_ = false;
+  int wokenBy = wokenBy_;
+  wokenBy_ = -1;
+  return wokenBy;
+}
+
+void PendingFire::checkReady()
+{
+  // Fires waiting for capacity are woken by the place
+  if(ready() && !queued_ && waitingPlace_ == -1)
+  {
+    queued_ = true;
+    readyFires_->push_back(this);
+  }
+}
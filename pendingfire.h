@@ -0,0 +1,111 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+#ifndef PETRINET_PENDINGFIRE_H
+#define PETRINET_PENDINGFIRE_H
+
+#include <list>
+#include <vector>
+
+#include "fire.h"
+#include "fireplan.h"
+#include "ringbuffer.h"
+
+namespace petrinet
+{
+
+  class PendingFire;
+  class Token;
+
+  // Input dependency of a pending fire: token must be present amount times in place
+  struct FireDependency
+  {
+    PendingFire* fire;
+    int place;
+    Token* token;
+    int amount;
+  };
+
+  // Queued fire that counts its missing inputs, places update the counter when
+  // tokens are put or taken. Once complete the fire goes to the ready queue.
+  // A ready fire blocked by a bounded output place waits in that place until a
+  // token is taken from it.
+  class PendingFire
+  {
+  public:
+    PendingFire(int transition, const Fire& f, RingBuffer<PendingFire*>* readyFires);
+
+    int transition() const { return transition_; }
+    const Fire& fire() const { return fire_; }
+    FirePlan& plan() { return plan_; }
+    std::vector<FireDependency>& dependencies() { return dependencies_; }
+
+    // The ready queue moves when compile regroups the conflict components
+    void setReadyFires(RingBuffer<PendingFire*>* readyFires) { readyFires_ = readyFires; }
+
+    bool ready() const { return missingInputs_ == 0; }
+
+    void addDependency(int place, Token* token, int amount, bool present);
+
+    void inputSatisfied();
+    void inputMissing();
+
+    // Place the fire waits in for capacity, -1 if none
+    int waitingPlace() const { return waitingPlace_; }
+    void waitForCapacity(int place) { waitingPlace_ = place; }
+    // False if it lost an input meanwhile, the capacity goes to the next
+    // waiting fire. It is queued again once its inputs are back.
+    bool capacityAvailable();
+
+    // Cleared when taken from the ready queue, returns the place that woke it
+    int dequeued();
+    bool queued() const { return queued_; }
+
+    // Dropped while in the ready queue, removed once taken from it
+    bool discarded() const { return discarded_; }
+    void discard() { discarded_ = true; }
+
+    std::list<PendingFire>::iterator self_;
+    // Handle slot of the fire
+    int slot_;
+    // Pending fires for the same token in the conflict component
+    PendingFire* previousInComponent_;
+    PendingFire* nextInComponent_;
+
+  private:
+    void checkReady();
+
+    int transition_;
+    Fire fire_;
+    FirePlan plan_;
+    std::vector<FireDependency> dependencies_;
+    int missingInputs_;
+    bool queued_;
+    bool discarded_;
+    int waitingPlace_;
+    int wokenBy_;
+    RingBuffer<PendingFire*>* readyFires_;
+  };
+}
+
+#endif
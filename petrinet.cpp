@@ -22,7 +22,9 @@
  **/
 
 #include <algorithm>
+#include <future>
 #include <iostream>
+#include <numeric>
 
 #include "algorithm.h"
 #include "petrinet.h"
@@ -87,213 +89,1497 @@ class LogPetriNetImplFire
 
 bool basicCompare(int a, int b) { return a == b; }
 
+// A typed transition only takes fires carrying its arguments and a token of
+// its type, the action casts both without checking
+bool isTypedFor(const Transition& tr, const Fire& f)
+{
+  if(!tr.action())
+    return true;
+  return (tr.action()->arity() == 0 || f.typedArguments()) && tr.action()->accepts(f.token().get());
+}
+
+// Chains a queued fire to the other fires of its conflict component for the
+// same token, the head of the chain is kept by token
+template<class T>
+void chainByToken(FlatMap<Token*, T*, PointerHash>& heads, Token* token, T* fire, T* T::* previous, T* T::* next)
+{
+  fire->*previous = nullptr;
+  fire->*next = nullptr;
+  if(!token)
+    return;
+
+  std::pair<T**, bool> head = heads.insert(token, fire);
+  if(!head.second)
+  {
+    fire->*next = *head.first;
+    (*head.first)->*previous = fire;
+    *head.first = fire;
+  }
+}
+
+template<class T>
+void unchainByToken(FlatMap<Token*, T*, PointerHash>& heads, Token* token, T* fire, T* T::* previous, T* T::* next)
+{
+  if(!token)
+    return;
+
+  if(fire->*previous)
+    (fire->*previous)->*next = fire->*next;
+  else if(fire->*next)
+    *heads.find(token) = fire->*next;
+  else
+    heads.erase(token);
+  if(fire->*next)
+    (fire->*next)->*previous = fire->*previous;
+}
+
 PetriNetImpl::PetriNetImpl()
-  : logger_(new FileLogControl("PetriNetImpl"))
+  : queueDepth_(0),
+  queueLimit_(-1),
+  overflow_(Overflow::Reject),
+  propagation_(Propagation::Worklist),
+  scheduling_(Scheduling::Fifo),
+  sharded_(false),
+  pendingSubmissions_(0),
+  compiled_(true),
+  reserveSize_(0),
+  logger_(new FileLogControl("PetriNetImpl"))
+{
+}
+
+PetriNetImpl::~PetriNetImpl()
+{
+  // Pending timers are dropped, the others are done before the threads
+  // working on the net stop
+  if(timers_)
+  {
+    std::promise<void> cleared;
+    shards_.front()->owner.get().post([this, &cleared]
+    {
+      pendingSubmissions_ -= timers_->clear();
+      cleared.set_value();
+    });
+    cleared.get_future().wait();
+  }
+
+  waitForSubmitted();
+
+  // The wheel goes before the io_service driving it, once its cancelled
+  // tick ran
+  if(timers_)
+  {
+    std::promise<void> destroyed;
+    shards_.front()->owner.get().post([this, &destroyed]
+    {
+      timers_.reset();
+      destroyed.set_value();
+    });
+    destroyed.get_future().wait();
+  }
+  shards_.clear();
+}
+
+void PetriNetImpl::compile()
+{
+  consumers_.assign(places_.size(), std::vector<int>());
+  producers_.assign(places_.size(), std::vector<int>());
+  joinConsumers_.assign(places_.size(), std::vector<int>());
+  blockedJoins_.resize(places_.size());
+
+  for(size_t t = 0; t < transitions_.size(); ++t)
+  {
+    Transition& tr = transitions_[t];
+    tr.compile(placeIndices_);
+
+    for(const Arc* arc = tr.inputArcsBegin(); arc != tr.inputArcsEnd(); ++arc)
+    {
+      consumers_[arc->place].push_back(t);
+
+      // A join binds one token of each input place by its key
+      if(tr.join())
+      {
+        assert(places_[arc->place].keyed() && arc->weight == 1);
+        joinConsumers_[arc->place].push_back(t);
+      }
+    }
+
+    for(const Arc* arc = tr.outputArcsBegin(); arc != tr.outputArcsEnd(); ++arc)
+      producers_[arc->place].push_back(t);
+  }
+
+  // Union the places linked by each transition. Any shared place is a
+  // conflict, even an unbounded one: its marking is not safe to update from
+  // two threads. Sharded, the owner of an unbounded place is the only one
+  // touching it, producers hand their tokens off. Anonymous tokens cannot be
+  // handed off, counter places stay with their producers.
+  std::vector<int> roots(places_.size());
+  std::iota(roots.begin(), roots.end(), 0);
+  auto findRoot = [&roots](int p)
+  {
+    while(roots[p] != p)
+      p = roots[p] = roots[roots[p]];
+    return p;
+  };
+
+  for(size_t t = 0; t < transitions_.size(); ++t)
+  {
+    const Transition& tr = transitions_[t];
+    const Arc* first = nullptr;
+    for(const Arc* arc = tr.inputArcsBegin(); arc != tr.outputArcsEnd(); ++arc)
+    {
+      if(sharded_ && arc >= tr.outputArcsBegin() && places_[arc->place].capacity() == -1 && !places_[arc->place].counter())
+        continue;
+
+      if(first)
+        roots[findRoot(arc->place)] = findRoot(first->place);
+      else
+        first = arc;
+    }
+  }
+
+  int componentCount = 0;
+  std::vector<int> rootComponents(places_.size(), -1);
+  placeComponents_.resize(places_.size());
+  for(size_t p = 0; p < places_.size(); ++p)
+  {
+    int& component = rootComponents[findRoot(p)];
+    if(component == -1)
+      component = componentCount++;
+    placeComponents_[p] = component;
+  }
+
+  std::vector<int> componentSizes(componentCount, 0);
+  transitionComponents_.resize(transitions_.size());
+  for(size_t t = 0; t < transitions_.size(); ++t)
+  {
+    const Transition& tr = transitions_[t];
+    const Arc* arc = tr.inputArcsBegin();
+    while(arc != tr.outputArcsEnd() && sharded_ && arc >= tr.outputArcsBegin() && places_[arc->place].capacity() == -1
+          && !places_[arc->place].counter())
+      ++arc;
+
+    if(arc != tr.outputArcsEnd())
+      transitionComponents_[t] = placeComponents_[arc->place];
+    else
+    {
+      transitionComponents_[t] = componentCount++;
+      componentSizes.push_back(0);
+    }
+    ++componentSizes[transitionComponents_[t]];
+  }
+
+  // Largest components first, each to the shard with the fewest transitions
+  componentShards_.assign(componentCount, 0);
+  if(shards_.size() > 1)
+  {
+    std::vector<int> order(componentCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&componentSizes](int l, int r){ return componentSizes[l] > componentSizes[r]; });
+
+    std::vector<int> shardSizes(shards_.size(), 0);
+    for(auto it = order.begin(); it != order.end(); ++it)
+    {
+      int shard = std::min_element(shardSizes.begin(), shardSizes.end()) - shardSizes.begin();
+      componentShards_[*it] = shard;
+      shardSizes[shard] += componentSizes[*it];
+    }
+  }
+
+  // Apart from the chains of queued fires, propagation state is only kept
+  // during a pass and empty here
+  components_.resize(componentCount);
+  for(auto it = components_.begin(); it != components_.end(); ++it)
+  {
+    it->queuedByToken.clear();
+    it->pendingByToken.clear();
+  }
+
+  // Transitions are only appended, queued fires of existing ones stay valid
+  size_t oldSize = queuedFires_.size();
+  queuedFires_.resize(transitions_.size());
+  pendingFires_.resize(transitions_.size());
+  fireSlots_.resize(transitions_.size());
+  freeFireSlots_.resize(transitions_.size());
+  for(size_t t = oldSize; t < queuedFires_.size(); ++t)
+  {
+    queuedFires_[t].setScheduling(scheduling_);
+    queuedFires_[t].reserve(reserveSize_);
+  }
+
+  for(size_t t = 0; t < oldSize; ++t)
+  {
+    PropagationState& state = components_[transitionComponents_[t]];
+    for(ParkedFires::Entry* entry = queuedFires_[t].oldest(); entry; entry = entry->next)
+      chainByToken(state.queuedByToken, entry->fire.token().get(), entry, &ParkedFires::Entry::previousInComponent, &ParkedFires::Entry::nextInComponent);
+
+    // Discarded fires only wait to leave the ready queue
+    std::list<PendingFire>& pendingFires = pendingFires_[t];
+    for(auto it = pendingFires.begin(); it != pendingFires.end(); ++it)
+    {
+      it->setReadyFires(&state.readyFires);
+      if(!it->discarded())
+        chainByToken(state.pendingByToken, it->fire().token().get(), &*it, &PendingFire::previousInComponent_, &PendingFire::nextInComponent_);
+    }
+  }
+
+  compiled_ = true;
+}
+
+void PetriNetImpl::setPropagation(Propagation propagation)
 {
+  // Queued fires are stored differently for each propagation
+  assert(std::all_of(queuedFires_.begin(), queuedFires_.end(), [](const ParkedFires& q){ return q.empty(); }));
+  assert(std::all_of(pendingFires_.begin(), pendingFires_.end(), [](const std::list<PendingFire>& q){ return q.empty(); }));
+  // Pending fires are woken in FIFO order
+  assert(propagation != Propagation::Incremental || scheduling_ == Scheduling::Fifo);
+  propagation_ = propagation;
 }
 
-void PetriNetImpl::queueFire(const Fire& f)
-{
-  if(!canFire(f))
+void PetriNetImpl::setScheduling(Scheduling scheduling)
+{
+  assert(propagation_ != Propagation::Incremental || scheduling == Scheduling::Fifo);
+  scheduling_ = scheduling;
+  for(auto it = queuedFires_.begin(); it != queuedFires_.end(); ++it)
+    it->setScheduling(scheduling);
+}
+
+void PetriNetImpl::setLogging(bool logging)
+{
+  logger_.setEnabled(logging);
+}
+
+void PetriNetImpl::setParallel(int threads)
+{
+  workers_.reset(threads > 0 ? new WorkerPool(threads) : nullptr);
+}
+
+void PetriNetImpl::setActionThreads(int threads)
+{
+  actions_.reset(threads > 0 ? new ActionPool(threads) : nullptr);
+}
+
+void PetriNetImpl::waitForActions()
+{
+  if(actions_)
+    actions_->wait();
+}
+
+void PetriNetImpl::setDelay(int transitionId, std::chrono::milliseconds delay)
+{
+  transitions_[transitionIndices_.find(transitionId)->second].setDelay(delay);
+}
+
+void PetriNetImpl::setQueueLimit(int limit)
+{
+  queueLimit_ = limit;
+}
+
+void PetriNetImpl::setQueueLimit(int transitionId, int limit)
+{
+  transitions_[transitionIndices_.find(transitionId)->second].setQueueLimit(limit);
+}
+
+void PetriNetImpl::setOverflow(Overflow overflow, const std::function<void(const Fire&)>& handler)
+{
+  overflow_ = overflow;
+  overflowHandler_ = handler;
+}
+
+int PetriNetImpl::queueDepth() const
+{
+  return queueDepth_;
+}
+
+int PetriNetImpl::queueDepth(int transitionId) const
+{
+  int transition = transitionIndices_.find(transitionId)->second;
+  if(transition >= (int) queuedFires_.size())
+    return 0;
+  return queuedFires_[transition].size() + pendingFires_[transition].size();
+}
+
+void PetriNetImpl::setShards(int shards)
+{
+  assert(pendingSubmissions_ == 0);
+
+  // No timer is pending, the wheel is idle
+  timers_.reset();
+  shards_.clear();
+  for(int i = 0; i < std::max(shards, 1); ++i)
+    shards_.push_back(std::unique_ptr<Shard>(new Shard()));
+  timers_.reset(new TimingWheel(shards_.front()->owner.get()));
+
+  sharded_ = shards > 1;
+  compile();
+}
+
+FireHandle PetriNetImpl::queueFire(const Fire& f)
+{
+  if(!compiled_)
+    compile();
+
+  int transition = transitionIndices_.find(f.transitionId())->second;
+  const Transition& tr = transitions_[transition];
+
+  // A join fires for the tokens it binds, not for a queued fire
+  assert(!tr.join());
+
+  // The action of a typed transition would read arguments the fire lacks,
+  // or cast its token to the wrong type
+  if(!isTypedFor(tr, f))
+    return reject(f);
+
+  // The delay runs on the thread owning the net, only a submitted fire
+  // waits for it
+  if(tr.delay().count() > 0)
+    return reject(f);
+
+  return queueFire(transition, f);
+}
+
+void PetriNetImpl::queueSubmittedFire(const Fire& f)
+{
+  if(!compiled_)
+    compile();
+
+  // Comes back through the submissions once the delay passed
+  const Transition& tr = transitions_[transitionIndices_.find(f.transitionId())->second];
+  if(!isTypedFor(tr, f))
+    reject(f);
+  else if(tr.delay().count() > 0)
+    submitAfter(tr.delay(), new Submission(Submission::DelayedFire, -1, f));
+  else
+    queueFire(f);
+}
+
+FireHandle PetriNetImpl::reject(const Fire& f)
+{
+  if(overflowHandler_)
+    overflowHandler_(f);
+  return FireHandle(QueueResult::Rejected);
+}
+
+FireHandle PetriNetImpl::queueFire(int transition, const Fire& f)
+{
+  FireHandle handle = insertFire(transition, f, true);
+  propagate(transitionComponents_[transition]);
+  return handle;
+}
+
+bool PetriNetImpl::cancel(const FireHandle& handle)
+{
+  if(handle.slot_ == -1)
+    return false;
+
+  FireSlot& slot = fireSlots_[handle.transition_][handle.slot_];
+  if(slot.generation != handle.generation_)
+    return false;
+
+  if(propagation_ == Propagation::Incremental)
+    discard(slot.pending);
+  else
+    takeQueued(handle.transition_, slot.queued);
+  return true;
+}
+
+int PetriNetImpl::cancelFires(const SharedTreePointer<Token>& token)
+{
+  if(!token.get())
+    return 0;
+
+  // Each component chains the fires of the token over its transitions,
+  // withdrawing a fire takes it out of the chain
+  int cancelled = 0;
+  for(auto it = components_.begin(); it != components_.end(); ++it)
+  {
+    if(propagation_ == Propagation::Incremental)
+    {
+      while(PendingFire** pendingFire = it->pendingByToken.find(token.get()))
+      {
+        discard(*pendingFire);
+        ++cancelled;
+      }
+    }
+    else
+    {
+      while(ParkedFires::Entry** entry = it->queuedByToken.find(token.get()))
+      {
+        takeQueued(transitionIndices_.find((*entry)->fire.transitionId())->second, *entry);
+        ++cancelled;
+      }
+    }
+  }
+  return cancelled;
+}
+
+void PetriNetImpl::queueFires(const std::vector<Fire>& fires)
+{
+  if(!compiled_)
+    compile();
+
+  // Components do not interact, each one queues its fires and propagates on
+  // its own
+  std::vector<std::vector<std::pair<int, const Fire*>>> batches;
+  std::unordered_map<int, int> batchIndices;
+  for(auto it = fires.begin(); it != fires.end(); ++it)
+  {
+    int transition = transitionIndices_.find(it->transitionId())->second;
+    if(!isTypedFor(transitions_[transition], *it) || transitions_[transition].delay().count() > 0)
+    {
+      reject(*it);
+      continue;
+    }
+
+    auto inserted = batchIndices.insert(std::pair<int, int>(transitionComponents_[transition], batches.size()));
+    if(inserted.second)
+      batches.push_back(std::vector<std::pair<int, const Fire*>>());
+    batches[inserted.first->second].push_back(std::pair<int, const Fire*>(transition, &*it));
+  }
+
+  std::vector<int> fired(batches.size(), 0);
+  auto queueBatch = [this, &batches, &fired](size_t b)
+  {
+    const std::vector<std::pair<int, const Fire*>>& batch = batches[b];
+    for(auto it = batch.begin(); it != batch.end(); ++it)
+      fired[b] += insertFire(it->first, *it->second, false).result() == QueueResult::Fired;
+
+    propagate(transitionComponents_[batch.front().first]);
+  };
+
+  if(workers_ && batches.size() > 1)
+  {
+    std::vector<std::function<void()>> tasks;
+    for(size_t b = 0; b < batches.size(); ++b)
+      tasks.push_back(std::bind(queueBatch, b));
+    workers_->runAll(tasks);
+  }
+  else
+  {
+    for(size_t b = 0; b < batches.size(); ++b)
+      queueBatch(b);
+  }
+
+  logQueueFires(fires.size(), std::accumulate(fired.begin(), fired.end(), 0));
+}
+
+void PetriNetImpl::addToken(int placeId, const SharedTreePointer<Token>& token)
+{
+  if(!compiled_)
+    compile();
+
+  int placeIndex = placeIndices_.find(placeId)->second;
+  places_[placeIndex].putToken(token);
+  addJoinCandidates(placeIndex, token);
+
+  int component = placeComponents_[placeIndex];
+  addArrivalCandidates(placeIndex, token, components_[component]);
+  propagate(component);
+}
+
+void PetriNetImpl::addTokens(int placeId, int amount)
+{
+  if(!compiled_)
+    compile();
+
+  int placeIndex = placeIndices_.find(placeId)->second;
+  places_[placeIndex].putTokens(amount);
+
+  int component = placeComponents_[placeIndex];
+  addArrivalCandidates(placeIndex, SharedTreePointer<Token>(), components_[component]);
+  propagate(component);
+}
+
+FireHandle PetriNetImpl::insertFire(int t, const Fire& f, bool log)
+{
+  PropagationState& state = components_[transitionComponents_[t]];
+  plan(t, f.token(), state.plan);
+  bool possible = canFire(state.plan);
+  if(log && logger_.enabled())
+    logger_.log(LogPetriNetImplQueueFire(f, getPlaceCounts(t), getTransitionCounts(t), possible));
+
+  if(!possible)
+  {
+    if(!makeRoom(t, f))
+    {
+      state.plan.release();
+      return FireHandle(QueueResult::Rejected);
+    }
+
+    // The queued fire keeps the plan for its next attempt
+    ++queueDepth_;
+    int slot = acquireSlot(t);
+    if(propagation_ == Propagation::Incremental)
+      park(t, f, slot, state.plan);
+    else
+    {
+      ParkedFires::Entry* entry = queuedFires_[t].insert(f, slot);
+      entry->plan.swap(state.plan);
+      fireSlots_[t][slot].queued = entry;
+      if(hasTokens(entry->plan))
+        queuedFires_[t].block(entry);
+      chainByToken(state.queuedByToken, f.token().get(), entry, &ParkedFires::Entry::previousInComponent, &ParkedFires::Entry::nextInComponent);
+    }
+    return FireHandle(QueueResult::Queued, t, slot, fireSlots_[t][slot].generation);
+  }
+
+  fire(t, f, state.plan);
+  state.plan.release();
+
+  // Gather all fires that might have become ready, the incremental
+  // propagation got them from the places already
+  if(propagation_ == Propagation::Search)
+    searchNextPossibleFires(t, f.token(), state.searchCandidates);
+  else if(propagation_ == Propagation::Worklist)
+    addNextPossibleFires(t, f.token(), state);
+
+  return FireHandle(QueueResult::Fired);
+}
+
+int PetriNetImpl::acquireSlot(int transition)
+{
+  std::vector<FireSlot>& slots = fireSlots_[transition];
+  std::vector<int>& freeSlots = freeFireSlots_[transition];
+  if(freeSlots.empty())
+  {
+    slots.push_back(FireSlot{0, nullptr, nullptr});
+    return slots.size() - 1;
+  }
+
+  int slot = freeSlots.back();
+  freeSlots.pop_back();
+  return slot;
+}
+
+void PetriNetImpl::releaseSlot(int transition, int slot)
+{
+  // Outdates the handles of the fire
+  FireSlot& fireSlot = fireSlots_[transition][slot];
+  ++fireSlot.generation;
+  fireSlot.queued = nullptr;
+  fireSlot.pending = nullptr;
+  freeFireSlots_[transition].push_back(slot);
+}
+
+void PetriNetImpl::takeQueued(int transition, ParkedFires::Entry* entry)
+{
+  PropagationState& state = components_[transitionComponents_[transition]];
+  unchainByToken(state.queuedByToken, entry->fire.token().get(), entry, &ParkedFires::Entry::previousInComponent, &ParkedFires::Entry::nextInComponent);
+  releaseSlot(transition, entry->slot);
+  queuedFires_[transition].erase(entry);
+  --queueDepth_;
+}
+
+bool PetriNetImpl::makeRoom(int transition, const Fire& f)
+{
+  int limit = transitions_[transition].queueLimit();
+  int depth = queuedFires_[transition].size() + pendingFires_[transition].size();
+  if((limit == -1 || depth < limit) && (queueLimit_ == -1 || queueDepth_ < queueLimit_))
+    return true;
+
+  if(overflow_ == Overflow::DropOldest && dropOldest(transition))
+    return true;
+
+  if(overflowHandler_)
+    overflowHandler_(f);
+  return false;
+}
+
+bool PetriNetImpl::dropOldest(int transition)
+{
+  // Without a queued fire of its own the transition cannot make room
+  Fire dropped;
+  if(propagation_ == Propagation::Incremental)
+  {
+    // Skip fires dropped earlier that wait to leave the ready queue
+    std::list<PendingFire>& pendingFires = pendingFires_[transition];
+    auto oldest = pendingFires.begin();
+    while(oldest != pendingFires.end() && oldest->discarded())
+      ++oldest;
+    if(oldest == pendingFires.end())
+      return false;
+
+    dropped = oldest->fire();
+    discard(&*oldest);
+  }
+  else
+  {
+    ParkedFires::Entry* oldest = queuedFires_[transition].oldest();
+    if(!oldest)
+      return false;
+
+    dropped = oldest->fire;
+    takeQueued(transition, oldest);
+  }
+
+  if(overflowHandler_)
+    overflowHandler_(dropped);
+  return true;
+}
+
+void PetriNetImpl::propagate(int component)
+{
+  PropagationState& state = components_[component];
+  while(true)
+  {
+    switch(propagation_)
+    {
+      case Propagation::Search:
+        propagateSearch(state);
+        break;
+      case Propagation::Worklist:
+        propagateWorklist(state);
+        break;
+      case Propagation::Incremental:
+        fireReadyFires(state);
+        break;
+    }
+
+    // Fired joins might make queued fires possible again
+    if(state.joinCandidates.empty())
+      break;
+    fireJoins(state);
+  }
+}
+
+void PetriNetImpl::propagateSearch(PropagationState& state)
+{
+  do
+  {
+    for(auto it = state.searchCandidates.begin(); it != state.searchCandidates.end();)
+    {
+      ParkedFires::Entry* entry = findPossibleFire(it->transition, it->token.get());
+      if(!entry)
+        it = state.searchCandidates.erase(it);
+      else
+      {
+        int firedTransition = it->transition;
+        Fire toFire = entry->fire;
+        state.plan.swap(entry->plan);
+        takeQueued(firedTransition, entry);
+        it = state.searchCandidates.erase(it);
+
+        fire(firedTransition, toFire, state.plan);
+        state.plan.release();
+
+        // Gather all fires that might have become ready
+        searchNextPossibleFires(firedTransition, toFire.token(), state.searchCandidates);
+        
+        break;
+      }
+    }
+  } while(state.searchCandidates.size());
+}
+
+void PetriNetImpl::propagateWorklist(PropagationState& state)
+{
+  while(!state.worklist.empty())
+  {
+    FireCandidate candidate = state.worklist.pop();
+    ParkedFires::Entry* entry = findPossibleFire(candidate.transition, candidate.token.get());
+    if(!entry)
+      continue;
+
+    Fire toFire = entry->fire;
+    state.plan.swap(entry->plan);
+    takeQueued(candidate.transition, entry);
+    fire(candidate.transition, toFire, state.plan);
+    state.plan.release();
+
+    // Another fire queued for the same candidate might be possible as well
+    state.worklist.push(candidate);
+    addNextPossibleFires(candidate.transition, toFire.token(), state);
+  }
+}
+
+ParkedFires::Entry* PetriNetImpl::findPossibleFire(int transition, Token* token)
+{
+  ParkedFires& queuedFiresForTransition = queuedFires_[transition];
+  if(token)
+  {
+    ParkedFires::Entry* entry = queuedFiresForTransition.find(token);
+    if(!entry)
+      return nullptr;
+
+    // With its tokens in place, anonymous tokens or capacity let it fire
+    const FirePlan& firePlan = plan(transition, entry);
+    if(canFire(firePlan))
+      return entry;
+    if(hasTokens(firePlan))
+      queuedFiresForTransition.block(entry);
+    return nullptr;
+  }
+
+  // Anonymous tokens or spare capacity go to the next fire by the scheduling
+  // among those with their tokens in place, as the incremental propagation
+  // wakes the fires waiting for capacity. Fires that lost a token wait for
+  // it to come back.
+  while(ParkedFires::Entry* entry = queuedFiresForTransition.firstBlocked())
+  {
+    const FirePlan& firePlan = plan(transition, entry);
+    if(hasTokens(firePlan))
+      return canFire(firePlan) ? entry : nullptr;
+    queuedFiresForTransition.unblock(entry);
+  }
+  return nullptr;
+}
+
+bool PetriNetImpl::hasTokens(const FirePlan& plan) const
+{
+  for(auto step = plan.inputs.begin(); step != plan.inputs.end(); ++step)
+  {
+    if(step->level == -1)
+      continue;
+
+    const Place& pl = places_[step->place];
+    for(const SharedTreePointer<Token>* token = plan.begin(*step); token != plan.end(*step); ++token)
+    {
+      if(pl.tokens().count(*token) < step->weight)
+        return false;
+    }
+  }
+  return true;
+}
+
+bool PetriNetImpl::canFire(const Fire& f) const
+{
+  assert(compiled_);
+  FirePlan firePlan;
+  int transition = transitionIndices_.find(f.transitionId())->second;
+  plan(transition, f.token(), firePlan);
+  return canFire(firePlan);
+}
+
+void PetriNetImpl::plan(int transition, const SharedTreePointer<Token>& token, FirePlan& plan) const
+{
+  // The steps only change with the transition, the levels of the places
+  // are shared by the steps at the same level
+  if(plan.transition != transition)
+  {
+    plan.transition = transition;
+    plan.inputs.clear();
+    plan.outputs.clear();
+    plan.levels.clear();
+
+    auto levelOf = [&plan](const Place& pl)
+    {
+      if(pl.counter())
+        return -1;
+      for(int i = 0; i < (int) plan.levels.size(); ++i)
+      {
+        if(plan.levels[i].level == pl.level())
+          return i;
+      }
+      plan.levels.push_back(FirePlan::Level{pl.level(), 0, 0});
+      return (int) plan.levels.size() - 1;
+    };
+
+    const Transition& tr = transitions_[transition];
+    for(const Arc* arc = tr.inputArcsBegin(); arc != tr.inputArcsEnd(); ++arc)
+      plan.inputs.push_back(FirePlan::Step{arc->place, arc->weight, levelOf(places_[arc->place])});
+    for(const Arc* arc = tr.outputArcsBegin(); arc != tr.outputArcsEnd(); ++arc)
+      plan.outputs.push_back(FirePlan::Step{arc->place, arc->weight, levelOf(places_[arc->place])});
+  }
+
+  plan.tokens.clear();
+  for(auto it = plan.levels.begin(); it != plan.levels.end(); ++it)
+  {
+    // Firing a transition with a token of a deeper level than any of it's linked places
+    // is not defined.
+    assert(token.level() <= it->level);
+
+    it->first = plan.tokens.size();
+    if(token.level() == it->level)
+      plan.tokens.push_back(token);
+    else
+    {
+      for(auto childTokenIter = token.levelBegin(it->level); childTokenIter != token.levelEnd(); ++childTokenIter)
+        plan.tokens.push_back(*childTokenIter);
+    }
+    it->size = plan.tokens.size() - it->first;
+  }
+  plan.resolved = true;
+}
+
+const FirePlan& PetriNetImpl::plan(int transition, ParkedFires::Entry* entry) const
+{
+  if(!entry->plan.resolved)
+    plan(transition, entry->fire.token(), entry->plan);
+  return entry->plan;
+}
+
+bool PetriNetImpl::canFire(const FirePlan& plan) const
+{
+  for(auto step = plan.inputs.begin(); step != plan.inputs.end(); ++step)
+  {
+    const Place& pl = places_[step->place];
+
+    // Anonymous tokens, only their number matters
+    if(step->level == -1)
+    {
+      if(pl.size() < step->weight)
+        return false;
+      continue;
+    }
+
+    for(const SharedTreePointer<Token>* token = plan.begin(*step); token != plan.end(*step); ++token)
+    {
+      if(pl.tokens().count(*token) < step->weight)
+        return false;
+    }
+  }
+
+  for(auto step = plan.outputs.begin(); step != plan.outputs.end(); ++step)
+  {
+    if(!places_[step->place].hasCapacityLeft(plan.amount(*step)))
+      return false;
+  }
+
+  return true;
+}
+
+void PetriNetImpl::fire(const Fire& f)
+{
+  if(!compiled_)
+    compile();
+
+  int transition = transitionIndices_.find(f.transitionId())->second;
+  PropagationState& state = components_[transitionComponents_[transition]];
+  plan(transition, f.token(), state.plan);
+  fire(transition, f, state.plan);
+  state.plan.release();
+}
+
+void PetriNetImpl::fire(int transition, const Fire& f, const FirePlan& plan)
+{
+  if(logger_.enabled())
+    logger_.log(LogPetriNetImplFire(f, getPlaceCounts(transition), getTransitionCounts(transition)));
+
+  const Transition& tr = transitions_[transition];
+  if(!actions_)
+  {
+    if(tr.action())
+      tr.action()->invoke(f.token().get(), f.typedArguments());
+    else if(tr.func())
+      tr.func()(f.token().get(), f.a(), f.b(), f.c());
+  }
+
+  for(auto step = plan.inputs.begin(); step != plan.inputs.end(); ++step)
+  {
+    Place& pl = places_[step->place];
+    if(step->level == -1)
+      pl.takeTokens(step->weight);
+    else
+    {
+      for(const SharedTreePointer<Token>* token = plan.begin(*step); token != plan.end(*step); ++token)
+        pl.takeToken(*token, step->weight);
+    }
+    retryBlockedJoins(step->place);
+  }
+
+  for(auto step = plan.outputs.begin(); step != plan.outputs.end(); ++step)
+  {
+    Place& pl = places_[step->place];
+    if(step->level == -1)
+    {
+      pl.putTokens(step->weight);
+      continue;
+    }
+
+    // Only sharded, the place belongs to another component
+    bool handOff = placeComponents_[step->place] != transitionComponents_[transition];
+
+    for(const SharedTreePointer<Token>* token = plan.begin(*step); token != plan.end(*step); ++token)
+    {
+      if(!handOff)
+      {
+        pl.putToken(*token, step->weight);
+        addJoinCandidates(step->place, *token);
+      }
+      else
+      {
+        for(int i = 0; i < step->weight; ++i)
+          submit(new Submission(Submission::HandOff, step->place, f, *token));
+      }
+    }
+  }
+
+  // The tokens are committed, the action does not hold up the net
+  if(actions_)
+  {
+    if(tr.action())
+      actions_->execute(tr.action(), f);
+    else if(tr.func())
+      actions_->execute(tr.func(), f);
+  }
+}
+
+void PetriNetImpl::searchNextPossibleFires(int transition, const SharedTreePointer<Token>& token, std::vector<FireCandidate>& fires) const
+{
+  // Appended to the candidates of the pass, their capacity is reused
+  const int first = fires.size();
+  const Transition& tr = transitions_[transition];
+  auto lessTransition = [](const FireCandidate& l, const FireCandidate& r){ return l.transition < r.transition; };
+  auto sameTransition = [](const FireCandidate& l, const FireCandidate& r){ return l.transition == r.transition; };
+
+  // Check whether a required place might have received a token, the owner
+  // of a handed off token checks itself
+  for(const Arc* arc = tr.outputArcsBegin(); arc != tr.outputArcsEnd(); ++arc)
+  {
+    if(placeComponents_[arc->place] != transitionComponents_[transition] || places_[arc->place].counter())
+      continue;
+
+    const std::vector<int>& consumers = consumers_[arc->place];
+    for(auto trIt = consumers.begin(); trIt != consumers.end(); ++trIt)
+      fires.push_back(FireCandidate{*trIt, token});
+  }
+
+  // A transition can consume from several of the output places
+  std::sort(fires.begin() + first, fires.end(), lessTransition);
+  fires.erase(std::unique(fires.begin() + first, fires.end(), sameTransition), fires.end());
+  const int tokenCandidates = fires.size();
+
+  // Check whether a required place might got spare capacity
+  for(const Arc* arc = tr.inputArcsBegin(); arc != tr.inputArcsEnd(); ++arc)
+  {
+    if(places_[arc->place].capacity() == -1)
+      continue;
+
+    const std::vector<int>& producers = producers_[arc->place];
+    for(auto trIt = producers.begin(); trIt != producers.end(); ++trIt)
+      fires.push_back(FireCandidate{*trIt, SharedTreePointer<Token>()});
+  }
+
+  // Anonymous tokens serve any queued fire of the consumers
+  for(const Arc* arc = tr.outputArcsBegin(); arc != tr.outputArcsEnd(); ++arc)
   {
-    logger_.log(LogPetriNetImplQueueFire(f, getPlaceCounts(), getTransitionCounts(), false));
-    queuedFires_[f.transitionId()].insert(std::pair<Token*, Fire>(f.token().get(), f));
-    return;
+    if(!places_[arc->place].counter())
+      continue;
+
+    const std::vector<int>& consumers = consumers_[arc->place];
+    for(auto trIt = consumers.begin(); trIt != consumers.end(); ++trIt)
+      fires.push_back(FireCandidate{*trIt, SharedTreePointer<Token>()});
   }
 
-  logger_.log(LogPetriNetImplQueueFire(f, getPlaceCounts(), getTransitionCounts(), true));
+  std::sort(fires.begin() + tokenCandidates, fires.end(), lessTransition);
+  fires.erase(std::unique(fires.begin() + tokenCandidates, fires.end(), sameTransition), fires.end());
+}
 
-  
+void PetriNetImpl::addNextPossibleFires(int transition, const SharedTreePointer<Token>& token, PropagationState& state) const
+{
+  const Transition& tr = transitions_[transition];
 
-  fire(f);
-  Fire oldF = f;
-  // Gather all fires that might have become ready
-  std::vector<Fire> firesToCheck = searchNextPossibleFires(oldF);
-  
-  do
+  // Check whether a required place might have received a token, the owner
+  // of a handed off token checks itself
+  for(const Arc* arc = tr.outputArcsBegin(); arc != tr.outputArcsEnd(); ++arc)
   {
-    for(auto it = firesToCheck.begin(); it != firesToCheck.end();)
+    if(placeComponents_[arc->place] != transitionComponents_[transition])
+      continue;
+
+    // Anonymous tokens serve any queued fire of the consumers
+    if(places_[arc->place].counter())
     {
-      std::unordered_multimap<Token*, Fire>& queuedFiresForTransition = queuedFires_[it->transitionId()];
-      auto fIt = it->token().get() ?
-        // Fire to check for specific token
-        queuedFiresForTransition.find(it->token().get()) :
-        // Fire to check for any token
-        queuedFiresForTransition.begin();
+      const std::vector<int>& consumers = consumers_[arc->place];
+      for(auto trIt = consumers.begin(); trIt != consumers.end(); ++trIt)
+        state.worklist.push(FireCandidate{*trIt, SharedTreePointer<Token>()});
+    }
+    else
+      addReceivingFires(arc->place, token, state);
+  }
 
-      if(fIt == queuedFiresForTransition.end() || !canFire(fIt->second))
-        it = firesToCheck.erase(it);
-      else
-      {
-        fire(fIt->second);
-        oldF = fIt->second;
-        queuedFiresForTransition.erase(fIt);
-        it = firesToCheck.erase(it);
+  // Check whether a required place might got spare capacity
+  for(const Arc* arc = tr.inputArcsBegin(); arc != tr.inputArcsEnd(); ++arc)
+  {
+    if(places_[arc->place].capacity() == -1)
+      continue;
 
-        // Gather all fires that might have become ready
-        std::vector<Fire> additionalFiresToCheck = searchNextPossibleFires(oldF);
-        firesToCheck.insert(firesToCheck.end(), additionalFiresToCheck.begin(), additionalFiresToCheck.end());
-        
-        break;
-      }
-    }
-  } while(firesToCheck.size());
+    const std::vector<int>& producers = producers_[arc->place];
+    for(auto trIt = producers.begin(); trIt != producers.end(); ++trIt)
+      state.worklist.push(FireCandidate{*trIt, SharedTreePointer<Token>()});
+  }
 }
 
-bool PetriNetImpl::canFire(const Fire& f) const
+void PetriNetImpl::addReceivingFires(int place, const SharedTreePointer<Token>& token, PropagationState& state) const
 {
-  const Transition& tr = transitions_.find(f.transitionId())->second;
-  std::list<int> inputPlaces = tr.inputPlaces();
-  for(auto it = inputPlaces.begin(); it != inputPlaces.end(); ++it)
+  // Only the consumers with a fire queued for this very token, found in
+  // their own queues
+  const std::vector<int>& consumers = consumers_[place];
+  for(auto trIt = consumers.begin(); trIt != consumers.end(); ++trIt)
   {
-    const Place& pl = places_.find(*it)->second;
-
-    // Firing a transition with a token of a deeper level than any of it's linked places
-    // is not defined.
-    assert(f.token().level() <= pl.level());
+    if(queuedFires_[*trIt].contains(token.get()))
+      state.worklist.push(FireCandidate{*trIt, token});
+  }
+}
 
-    // Performance boost calculation
-    if(f.token().level() == pl.level())
-    {
-      if(pl.tokens().count(f.token()) < tr.requiredTokens(*it))
-        return false;
-    }
-    // Performance boost calculation
-    else if(f.token().level()+1 == pl.level())
+void PetriNetImpl::addArrivalCandidates(int place, const SharedTreePointer<Token>& token, PropagationState& state) const
+{
+  // Tokens put from outside a fire, the incremental propagation got the
+  // fires from the place already. Anonymous tokens serve any queued fire.
+  const std::vector<int>& consumers = consumers_[place];
+  if(propagation_ == Propagation::Search)
+  {
+    for(auto trIt = consumers.begin(); trIt != consumers.end(); ++trIt)
+      state.searchCandidates.push_back(FireCandidate{*trIt, token});
+  }
+  else if(propagation_ == Propagation::Worklist)
+  {
+    if(!places_[place].counter())
+      addReceivingFires(place, token, state);
+    else
     {
-      for(int i = 0; i < f.token()->size(); ++i)
-      {
-        if(pl.tokens().count(f.token().child(i)) < tr.requiredTokens(*it))
-          return false;
-      }
+      for(auto trIt = consumers.begin(); trIt != consumers.end(); ++trIt)
+        state.worklist.push(FireCandidate{*trIt, token});
     }
-    // Calculates slowly, but can handle all situations
-    else
+  }
+}
+
+void PetriNetImpl::park(int transition, const Fire& f, int slot, FirePlan& plan)
+{
+  std::list<PendingFire>& pendingFires = pendingFires_[transition];
+  pendingFires.push_back(PendingFire(transition, f, &components_[transitionComponents_[transition]].readyFires));
+  PendingFire& pendingFire = pendingFires.back();
+  pendingFire.self_ = std::prev(pendingFires.end());
+  pendingFire.slot_ = slot;
+  fireSlots_[transition][slot].pending = &pendingFire;
+  chainByToken(components_[transitionComponents_[transition]].pendingByToken, f.token().get(), &pendingFire,
+               &PendingFire::previousInComponent_, &PendingFire::nextInComponent_);
+
+  pendingFire.plan().swap(plan);
+  const FirePlan& firePlan = pendingFire.plan();
+  for(auto step = firePlan.inputs.begin(); step != firePlan.inputs.end(); ++step)
+  {
+    const Place& pl = places_[step->place];
+    if(step->level == -1)
     {
-      for(auto childTokenIter = f.token().begin(pl.level()); childTokenIter != f.token().end(pl.level()); ++childTokenIter)
-      {
-        if(pl.tokens().count(*childTokenIter) < tr.requiredTokens(*it))
-          return false;
-      }
+      pendingFire.addDependency(step->place, nullptr, step->weight, pl.size() >= step->weight);
+      continue;
     }
+
+    for(const SharedTreePointer<Token>* token = firePlan.begin(*step); token != firePlan.end(*step); ++token)
+      pendingFire.addDependency(step->place, token->get(), step->weight, pl.tokens().count(*token) >= step->weight);
+  }
+
+  std::vector<FireDependency>& dependencies = pendingFire.dependencies();
+  for(auto it = dependencies.begin(); it != dependencies.end(); ++it)
+    places_[it->place].watch(&*it);
+
+  // Only blocked by capacity, wait in the first place lacking it
+  if(pendingFire.ready())
+  {
+    int blockingPlace = findBlockingOutput(firePlan);
+    pendingFire.waitForCapacity(blockingPlace);
+    places_[blockingPlace].waitForCapacity(&pendingFire, false);
+  }
+}
+
+void PetriNetImpl::unpark(PendingFire* pendingFire)
+{
+  assert(pendingFire->waitingPlace() == -1);
+
+  std::vector<FireDependency>& dependencies = pendingFire->dependencies();
+  for(auto it = dependencies.begin(); it != dependencies.end(); ++it)
+    places_[it->place].unwatch(&*it);
+
+  unindexPendingFire(pendingFire);
+  pendingFires_[pendingFire->transition()].erase(pendingFire->self_);
+  --queueDepth_;
+}
+
+void PetriNetImpl::unindexPendingFire(PendingFire* pendingFire)
+{
+  int transition = pendingFire->transition();
+  unchainByToken(components_[transitionComponents_[transition]].pendingByToken, pendingFire->fire().token().get(), pendingFire,
+                 &PendingFire::previousInComponent_, &PendingFire::nextInComponent_);
+  releaseSlot(transition, pendingFire->slot_);
+}
+
+void PetriNetImpl::discard(PendingFire* pendingFire)
+{
+  if(pendingFire->waitingPlace() != -1)
+  {
+    places_[pendingFire->waitingPlace()].stopWaiting(pendingFire);
+    pendingFire->waitForCapacity(-1);
   }
 
-  std::list<int> outputPlaces = transitions_.find(f.transitionId())->second.outputPlaces();
-  for(auto it = outputPlaces.begin(); it != outputPlaces.end(); ++it)
+  // Still referred to by the ready queue, removed when it is taken from it
+  if(pendingFire->queued())
   {
-    const Place& pl = places_.find(*it)->second;
+    std::vector<FireDependency>& dependencies = pendingFire->dependencies();
+    for(auto it = dependencies.begin(); it != dependencies.end(); ++it)
+      places_[it->place].unwatch(&*it);
+    dependencies.clear();
 
-    // Firing a transition with a token of a deeper level than any of it's linked places
-    // is not defined.
-    assert(f.token().level() <= pl.level());
+    unindexPendingFire(pendingFire);
+    pendingFire->discard();
+    --queueDepth_;
+  }
+  else
+    unpark(pendingFire);
+}
+
+int PetriNetImpl::findBlockingOutput(const FirePlan& plan) const
+{
+  for(auto step = plan.outputs.begin(); step != plan.outputs.end(); ++step)
+  {
+    const Place& pl = places_[step->place];
+    if(pl.capacity() != -1 && !pl.hasCapacityLeft(plan.amount(*step)))
+      return step->place;
+  }
+  return -1;
+}
+
+void PetriNetImpl::addJoinCandidates(int place, const SharedTreePointer<Token>& token)
+{
+  const std::vector<int>& joins = joinConsumers_[place];
+  if(joins.empty())
+    return;
+
+  // The joins share the component of their input places
+  PropagationState& state = components_[placeComponents_[place]];
+  JoinKey key = places_[place].key(token.get());
+  for(auto it = joins.begin(); it != joins.end(); ++it)
+    state.joinCandidates.push_back(JoinCandidate{*it, key});
+}
+
+void PetriNetImpl::retryBlockedJoins(int place)
+{
+  std::set<std::pair<int, JoinKey>>& blocked = blockedJoins_[place];
+  if(blocked.empty())
+    return;
+
+  // A place with a capacity shares the component of the joins producing
+  // into it
+  PropagationState& state = components_[placeComponents_[place]];
+  for(auto it = blocked.begin(); it != blocked.end(); ++it)
+    state.joinCandidates.push_back(JoinCandidate{it->first, it->second});
+  blocked.clear();
+}
+
+void PetriNetImpl::planJoin(int transition, const JoinBindings& bindings, FirePlan& plan) const
+{
+  // Each input takes its own bound token, the outputs get the one bound in
+  // the first input place
+  plan.transition = -1;
+  plan.inputs.clear();
+  plan.outputs.clear();
+  plan.levels.clear();
+  plan.tokens.clear();
+
+  const Transition& tr = transitions_[transition];
+  int i = 0;
+  for(const Arc* arc = tr.inputArcsBegin(); arc != tr.inputArcsEnd(); ++arc, ++i)
+  {
+    plan.inputs.push_back(FirePlan::Step{arc->place, 1, (int) plan.levels.size()});
+    plan.levels.push_back(FirePlan::Level{places_[arc->place].level(), (int) plan.tokens.size(), 1});
+    plan.tokens.push_back(bindings[i]);
+  }
 
-    // Performance boost calculation
-    if(f.token().level() == pl.level())
+  const SharedTreePointer<Token>& carrier = bindings.front();
+  for(const Arc* arc = tr.outputArcsBegin(); arc != tr.outputArcsEnd(); ++arc)
+  {
+    const Place& pl = places_[arc->place];
+    if(pl.counter())
     {
-      if(!pl.hasCapacityLeft(tr.requiredCapacity(*it)))
-        return false;
+      plan.outputs.push_back(FirePlan::Step{arc->place, arc->weight, -1});
+      continue;
     }
-    // Performance boost calculation
-    else if(f.token().level()+1 == pl.level())
+
+    assert(carrier.level() <= pl.level());
+    plan.outputs.push_back(FirePlan::Step{arc->place, arc->weight, (int) plan.levels.size()});
+    FirePlan::Level level{pl.level(), (int) plan.tokens.size(), 0};
+    if(carrier.level() == pl.level())
+      plan.tokens.push_back(carrier);
+    else
     {
-      if(!pl.hasCapacityLeft(f.token()->size() * tr.requiredCapacity(*it)))
-        return false;
+      for(auto it = carrier.levelBegin(pl.level()); it != carrier.levelEnd(); ++it)
+        plan.tokens.push_back(*it);
     }
-    // Calculates slowly, but can handle all situations
-    else if(!pl.hasCapacityLeft(std::distance(f.token().begin(pl.level()), f.token().end(pl.level()))
-                            * tr.requiredCapacity(*it)))
+    level.size = plan.tokens.size() - level.first;
+    plan.levels.push_back(level);
+  }
+  plan.resolved = true;
+}
+
+bool PetriNetImpl::fireJoin(const JoinCandidate& candidate, PropagationState& state)
+{
+  const Transition& tr = transitions_[candidate.transition];
+  JoinBindings& bindings = state.joinBindings;
+  bindings.clear();
+  for(const Arc* arc = tr.inputArcsBegin(); arc != tr.inputArcsEnd(); ++arc)
+  {
+    const SharedTreePointer<Token>* token = places_[arc->place].find(candidate.key);
+    if(!token)
       return false;
+    bindings.push_back(*token);
   }
 
+  planJoin(candidate.transition, bindings, state.plan);
+  if(!canFire(state.plan))
+  {
+    // The bound tokens are all there, only an output can be full
+    int blockingPlace = findBlockingOutput(state.plan);
+    assert(blockingPlace != -1);
+    blockedJoins_[blockingPlace].insert(std::make_pair(candidate.transition, candidate.key));
+    state.plan.release();
+    bindings.clear();
+    return false;
+  }
+
+  SharedTreePointer<Token> carrier = bindings.front();
+  fire(candidate.transition, Fire(transitionIds_[candidate.transition], carrier, boost::any(bindings)), state.plan);
+  state.plan.release();
+  bindings.clear();
+
+  if(propagation_ == Propagation::Search)
+    searchNextPossibleFires(candidate.transition, carrier, state.searchCandidates);
+  else if(propagation_ == Propagation::Worklist)
+    addNextPossibleFires(candidate.transition, carrier, state);
   return true;
 }
 
-void PetriNetImpl::fire(const Fire& f)
+void PetriNetImpl::fireJoins(PropagationState& state)
 {
-  logger_.log(LogPetriNetImplFire(f, getPlaceCounts(), getTransitionCounts()));
+  while(!state.joinCandidates.empty())
+  {
+    JoinCandidate candidate = state.joinCandidates.back();
+    state.joinCandidates.pop_back();
 
-  if(transitions_.find(f.transitionId())->second.func())
-    transitions_.find(f.transitionId())->second.func()(f.token().get(), f.a(), f.b(), f.c());
+    // More tokens with the key might be waiting in the places
+    if(fireJoin(candidate, state))
+      state.joinCandidates.push_back(candidate);
+  }
+}
 
-  std::list<int> inputPlaces = transitions_.find(f.transitionId())->second.inputPlaces();
-  for(auto it = inputPlaces.begin(); it != inputPlaces.end(); ++it)
+void PetriNetImpl::fireReadyFires(PropagationState& state)
+{
+  while(!state.readyFires.empty())
   {
-    const Place& pl = places_.find(*it)->second;
+    PendingFire* pendingFire = state.readyFires.front();
+    state.readyFires.pop_front();
+    int wokenBy = pendingFire->dequeued();
 
-    for(auto childTokenIter = f.token().begin(pl.level()); childTokenIter != f.token().end(pl.level()); ++childTokenIter)
+    if(pendingFire->discarded())
     {
-      places_.find(*it)->second.takeToken(*childTokenIter);
+      pendingFires_[pendingFire->transition()].erase(pendingFire->self_);
+      if(wokenBy != -1)
+        places_[wokenBy].wakeWaitingFire();
+      continue;
     }
-  }
 
-  std::list<int> outputPlaces = transitions_.find(f.transitionId())->second.outputPlaces();
-  for(auto it = outputPlaces.begin(); it != outputPlaces.end(); ++it)
-  {
-    const Place& pl = places_.find(*it)->second;
+    int blockingPlace = -1;
+
+    // An earlier fire might have taken its tokens again, it is queued again
+    // once they are back
+    if(pendingFire->ready())
+      blockingPlace = findBlockingOutput(pendingFire->plan());
 
-    for(auto childTokenIter = f.token().begin(pl.level()); childTokenIter != f.token().end(pl.level()); ++childTokenIter)
+    if(pendingFire->ready() && blockingPlace == -1)
     {
-      places_.find(*it)->second.putToken(*childTokenIter);
+      int transition = pendingFire->transition();
+      Fire f = pendingFire->fire();
+      state.plan.swap(pendingFire->plan());
+      unpark(pendingFire);
+      fire(transition, f, state.plan);
+      state.plan.release();
+      continue;
     }
+
+    if(blockingPlace != -1)
+    {
+      // Keeps its turn when the capacity it was woken for is still too small
+      pendingFire->waitForCapacity(blockingPlace);
+      places_[blockingPlace].waitForCapacity(pendingFire, blockingPlace == wokenBy);
+    }
+
+    // Pass the capacity it was woken for on to the next waiting fire
+    if(wokenBy != -1 && blockingPlace != wokenBy)
+      places_[wokenBy].wakeWaitingFire();
   }
 }
 
-std::vector<Fire> PetriNetImpl::searchNextPossibleFires(const Fire& oldF) const
+void PetriNetImpl::addPlace(int placeId, const Place& place)
+{
+  if(placeIndices_.find(placeId) != placeIndices_.end())
+    return;
+
+  placeIndices_.insert(std::pair<int, int>(placeId, places_.size()));
+  placeIds_.push_back(placeId);
+  places_.push_back(place);
+  compiled_ = false;
+}
+
+void PetriNetImpl::addTransition(int transitionId, const Transition& transition)
+{
+  if(transitionIndices_.find(transitionId) != transitionIndices_.end())
+    return;
+
+  transitionIndices_.insert(std::pair<int, int>(transitionId, transitions_.size()));
+  transitionIds_.push_back(transitionId);
+  transitions_.push_back(transition);
+  compiled_ = false;
+}
+
+Place& PetriNetImpl::place(int placeId)
+{
+  return places_[placeIndices_.find(placeId)->second];
+}
+
+const Place& PetriNetImpl::place(int placeId) const
+{
+  return places_[placeIndices_.find(placeId)->second];
+}
+
+void PetriNetImpl::reserve(int size)
 {
-  std::vector<Fire> fires;
+  reserveSize_ = size;
+  for(auto it = queuedFires_.begin(); it != queuedFires_.end(); ++it)
+    it->reserve(size);
+}
 
-  auto oldFoutputPlaces = transitions_.find(oldF.transitionId())->second.outputPlaces();
-  auto oldFinputPlaces = transitions_.find(oldF.transitionId())->second.inputPlaces();
-  for(auto transitionIt = transitions_.begin(); transitionIt != transitions_.end(); ++transitionIt)
+void PetriNetImpl::createOwner()
+{
+  std::call_once(ownerCreated_, [this]
   {
-    // Check whether a required place might have received a token
-    for(auto placeIt = oldFoutputPlaces.begin(); placeIt != oldFoutputPlaces.end(); ++placeIt)
+    if(shards_.empty())
     {
-      if(contains(transitionIt->second.inputPlaces(), *placeIt))
-      {
-        fires.push_back(Fire(transitionIt->first, oldF.token()));
-        break;
-      }
+      shards_.push_back(std::unique_ptr<Shard>(new Shard()));
+      timers_.reset(new TimingWheel(shards_.front()->owner.get()));
     }
+  });
+}
+
+void PetriNetImpl::submit(Submission* submission)
+{
+  createOwner();
+
+  // Counted before it is visible, waitForSubmitted must not miss it
+  ++pendingSubmissions_;
+  post(submission);
+}
+
+void PetriNetImpl::post(Submission* submission)
+{
+  Shard* shard = shards_[shardOf(*submission)].get();
+  shard->submissions.push(submission);
+
+  // Only one producer posts the handler, it drains everything pushed so far
+  if(!shard->drainActive.exchange(true))
+    shard->owner.get().post(std::bind(&PetriNetImpl::handleSubmissions, this, shard));
+}
 
-    // Check whether a required place might got spare capacity
-    for(auto placeIt = oldFinputPlaces.begin(); placeIt != oldFinputPlaces.end(); ++placeIt)
+void PetriNetImpl::submitAfter(std::chrono::milliseconds delay, Submission* submission)
+{
+  createOwner();
+
+  // Pending from now on, the count goes along with the submission once the
+  // timer expires. Only handleSubmissions lowers it, and notifies.
+  ++pendingSubmissions_;
+  std::shared_ptr<Submission> delayed(submission);
+  timers_->add(delay, [this, delayed]
+  {
+    post(new Submission(*delayed));
+  });
+}
+
+int PetriNetImpl::shardOf(const Submission& submission) const
+{
+  if(shards_.size() == 1)
+    return 0;
+
+  assert(compiled_);
+  switch(submission.type)
+  {
+    case Submission::QueueFire:
+    case Submission::DelayedFire:
+      return componentShards_[transitionComponents_[transitionIndices_.find(submission.fire.transitionId())->second]];
+    case Submission::AddToken:
+      return componentShards_[placeComponents_[placeIndices_.find(submission.place)->second]];
+    default:
+      return componentShards_[placeComponents_[submission.place]];
+  }
+}
+
+void PetriNetImpl::handleSubmissions(Shard* shard)
+{
+  shard->drainActive = false;
+
+  int processed = 0;
+  Submission* submission;
+  while(shard->submissions.pop(submission))
+  {
+    switch(submission->type)
     {
-      if(places_.find(*placeIt)->second.capacity() != -1
-         && contains(transitionIt->second.outputPlaces(), *placeIt))
-      {
-        fires.push_back(Fire(transitionIt->first, SharedTreePointer<Token>()));
+      case Submission::QueueFire:
+        queueSubmittedFire(submission->fire);
+        break;
+      case Submission::DelayedFire:
+        if(!compiled_)
+          compile();
+        queueFire(transitionIndices_.find(submission->fire.transitionId())->second, submission->fire);
+        break;
+      case Submission::AddToken:
+        addToken(submission->place, submission->fire.token());
+        break;
+      case Submission::HandOff:
+        handOff(submission->place, submission->token, submission->fire.token());
         break;
-      }
     }
+
+    delete submission;
+    ++processed;
   }
 
-  return fires;
+  if((pendingSubmissions_ -= processed) == 0)
+  {
+    std::unique_lock<std::mutex> lk(submittedMutex_);
+    submittedCv_.notify_all();
+  }
 }
 
-void PetriNetImpl::reserve(int size)
+void PetriNetImpl::handOff(int place, const SharedTreePointer<Token>& token, const SharedTreePointer<Token>& fireToken)
 {
-  for(auto it = queuedFires_.begin(); it != queuedFires_.end(); ++it)
-    it->second.reserve(size);
+  places_[place].putToken(token);
+  addJoinCandidates(place, token);
+
+  // The consumers are found as if the fire happened in this component
+  int component = placeComponents_[place];
+  addArrivalCandidates(place, fireToken, components_[component]);
+  propagate(component);
+}
+
+void PetriNetImpl::waitForSubmitted()
+{
+  std::unique_lock<std::mutex> lk(submittedMutex_);
+  submittedCv_.wait(lk, [this]{ return pendingSubmissions_ == 0; });
 }
 
-std::map<int, int> PetriNetImpl::getPlaceCounts() const
+void PetriNetImpl::logQueueFires(int count, int fired)
 {
+  if(logger_.enabled())
+    logger_.log([=]{ return std::string("PetriNetImpl::queueFires(") + std::to_string(count) + " fires) "
+                            + std::to_string(fired) + " fired immediately"; });
+}
+
+std::map<int, int> PetriNetImpl::getPlaceCounts(int transition) const
+{
+  // Only the places linked to the transition, logging must not scale with the net
   std::map<int, int> placeCounts_;
-  for(auto it = places_.begin(); it != places_.end(); ++it)
+  const Transition& tr = transitions_[transition];
+  for(const Arc* arc = tr.inputArcsBegin(); arc != tr.outputArcsEnd(); ++arc)
   {
-    placeCounts_.insert(std::pair<int, int>(it->first, it->second.tokens().size()));
+    // A place of another shard is not ours to read
+    if(placeComponents_[arc->place] != transitionComponents_[transition])
+      continue;
+
+    placeCounts_.insert(std::pair<int, int>(placeIds_[arc->place], places_[arc->place].size()));
   }
+
   return placeCounts_;
 }
 
-std::map<int, int> PetriNetImpl::getTransitionCounts() const
+std::map<int, int> PetriNetImpl::getTransitionCounts(int transition) const
 {
   std::map<int, int> transitionCounts_;
-  for(auto it = queuedFires_.begin(); it != queuedFires_.end(); ++it)
-  {
-    transitionCounts_.insert(std::pair<int, int>(it->first, it->second.size()));
-  }
+  transitionCounts_.insert(std::pair<int, int>(transitionIds_[transition], queuedFires_[transition].size() + pendingFires_[transition].size()));
   return transitionCounts_;
 }
 
@@ -314,31 +1600,168 @@ PetriNet::~PetriNet()
 
 void PetriNet::createPlace(int placeId, int capacity, int level)
 {
-  impl_.places_     .insert(std::pair<int, Place>(placeId, Place(capacity, level)));
-  impl_.queuedFires_.insert(std::pair<int, std::unordered_multimap<Token*, Fire>>(placeId,std::unordered_multimap<Token*, Fire>()));
+  impl_.addPlace(placeId, Place(capacity, level));
+}
+
+void PetriNet::createCounterPlace(int placeId, int capacity)
+{
+  impl_.addPlace(placeId, Place(capacity, 1, true));
+}
+
+void PetriNet::setPlaceKey(int placeId, const std::function<JoinKey(const Token*)>& key)
+{
+  impl_.place(placeId).setKey(key);
+}
+
+void PetriNet::createJoinTransition(int transitionId, const std::list<int>& inputPlaces, const Arcs& outputs,
+                                    const std::function<void(const JoinBindings&)>& action)
+{
+  // The bindings travel with the fire as its first argument
+  std::function<void(Token*, boost::any, boost::any, boost::any)> func;
+  if(action)
+    func = [action](Token*, boost::any bindings, boost::any, boost::any) { action(boost::any_cast<const JoinBindings&>(bindings)); };
+
+  Transition transition(inputPlaces, outputs, func);
+  transition.setJoin(true);
+  impl_.addTransition(transitionId, transition);
+}
+
+void PetriNet::compile()
+{
+  impl_.compile();
+}
+
+void PetriNet::setPropagation(Propagation propagation)
+{
+  impl_.setPropagation(propagation);
+}
+
+void PetriNet::setScheduling(Scheduling scheduling)
+{
+  impl_.setScheduling(scheduling);
+}
+
+void PetriNet::setParallel(int threads)
+{
+  impl_.setParallel(threads);
+}
+
+void PetriNet::setLogging(bool logging)
+{
+  impl_.setLogging(logging);
+}
+
+void PetriNet::setActionThreads(int threads)
+{
+  impl_.setActionThreads(threads);
+}
+
+void PetriNet::waitForActions()
+{
+  impl_.waitForActions();
+}
+
+
+
+
+FireHandle PetriNet::queueFire(int transitionId, SharedTreePointer<Token> token, boost::any a, boost::any b, boost::any c)
+{
+  assert(impl_.pendingSubmissions_ == 0);
+  return impl_.queueFire(Fire(transitionId, std::move(token), a, b, c));
+}
+
+void PetriNet::addToken(int placeId, const SharedTreePointer<Token>& token)
+{
+  assert(impl_.pendingSubmissions_ == 0);
+  impl_.addToken(placeId, token);
+}
+
+void PetriNet::addTokens(int placeId, int amount)
+{
+  assert(impl_.pendingSubmissions_ == 0);
+  impl_.addTokens(placeId, amount);
+}
+
+bool PetriNet::cancel(const FireHandle& handle)
+{
+  assert(impl_.pendingSubmissions_ == 0);
+  return impl_.cancel(handle);
+}
+
+int PetriNet::cancelFires(const SharedTreePointer<Token>& token)
+{
+  assert(impl_.pendingSubmissions_ == 0);
+  return impl_.cancelFires(token);
+}
+
+void PetriNet::submitFire(int transitionId, SharedTreePointer<Token> token, boost::any a, boost::any b, boost::any c)
+{
+  impl_.submit(new Submission(Submission::QueueFire, -1, Fire(transitionId, std::move(token), a, b, c)));
+}
+
+void PetriNet::submitToken(int placeId, SharedTreePointer<Token> token)
+{
+  impl_.submit(new Submission(Submission::AddToken, placeId, Fire(-1, std::move(token))));
+}
+
+void PetriNet::submitFireAfter(std::chrono::milliseconds delay, int transitionId, SharedTreePointer<Token> token, boost::any a, boost::any b, boost::any c)
+{
+  impl_.submitAfter(delay, new Submission(Submission::QueueFire, -1, Fire(transitionId, std::move(token), a, b, c)));
+}
+
+void PetriNet::waitForSubmitted()
+{
+  impl_.waitForSubmitted();
+}
+
+void PetriNet::setShards(int shards)
+{
+  impl_.setShards(shards);
+}
+
+void PetriNet::setDelay(int transitionId, std::chrono::milliseconds delay)
+{
+  impl_.setDelay(transitionId, delay);
+}
+
+void PetriNet::setQueueLimit(int limit)
+{
+  impl_.setQueueLimit(limit);
 }
 
+void PetriNet::setQueueLimit(int transitionId, int limit)
+{
+  impl_.setQueueLimit(transitionId, limit);
+}
 
+void PetriNet::setOverflow(Overflow overflow, std::function<void(const Fire&)> handler)
+{
+  impl_.setOverflow(overflow, handler);
+}
 
+int PetriNet::queueDepth() const
+{
+  return impl_.queueDepth();
+}
 
-void PetriNet::queueFire(int transitionId, SharedTreePointer<Token> token, boost::any a, boost::any b, boost::any c)
+int PetriNet::queueDepth(int transitionId) const
 {
-  impl_.queueFire(Fire(transitionId, token, a, b, c));
+  return impl_.queueDepth(transitionId);
 }
 
-void PetriNet::addToken(int placeId, SharedTreePointer<Token> token)
+void PetriNet::createTransition(int transitionId, const Arcs& inputs, const Arcs& outputs)
 {
-  impl_.places_.find(placeId)->second.putToken(token);
+  impl_.addTransition(transitionId, Transition(inputs, outputs, std::function<void(Token*, boost::any, boost::any, boost::any)>()));
 }
 
-void PetriNet::createTransition(int transitionId, const std::list<int>& inputPlaces, const std::list<int>& outputPlaces)
+const Marking& PetriNet::tokens(int placeId) const
 {
-  impl_.transitions_.insert(std::pair<int, Transition>(transitionId, Transition(inputPlaces, outputPlaces, std::function<void(Token*, boost::any, boost::any, boost::any)>())));
+  return impl_.place(placeId).tokens();
 }
 
-const std::unordered_multiset<SharedTreePointer<Token>>& PetriNet::tokens(int placeId) const
+int PetriNet::tokenCount(int placeId) const
 {
-  return impl_.places_.find(placeId)->second.tokens();
+  return impl_.place(placeId).size();
 }
 
 void PetriNet::reserve(int size)
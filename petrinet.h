@@ -24,50 +24,331 @@
 #ifndef PETRINET_PETRINET_H
 #define PETRINET_PETRINET_H
 
+#include <cassert>
+#include <deque>
 #include <functional>
 #include <list>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+#include <boost/atomic.hpp>
+#include <boost/lockfree/queue.hpp>
+
+#include "actionpool.h"
 #include "fire.h"
+#include "fireplan.h"
+#include "flatmap.h"
 #include "logger.h"
+#include "parkedfires.h"
+#include "pendingfire.h"
 #include "place.h"
+#include "ringbuffer.h"
 #include "sharedtreepointer.h"
+#include "timingwheel.h"
 #include "transition.h"
+#include "workerpool.h"
+#include "worklist.h"
 
 namespace petrinet
 {
 
   class Token;
 
+  // How queued fires that might have become possible are found
+  enum class Propagation
+  {
+    // Probe the queued fires of the transitions around each fired transition,
+    // restarting the scan after every fire
+    Search,
+    // Candidates around each fired transition go to a FIFO without duplicates
+    // and are processed until it runs empty
+    Worklist,
+    // Queued fires count their missing inputs, the places update these
+    // counters and a fire is ready as soon as nothing is missing
+    Incremental
+  };
+
+  // Outcome of queueing a fire
+  enum class QueueResult
+  {
+    Fired,
+    // Waits until it can fire
+    Queued,
+    // Not queued, the queue limit was reached, the transition is timed and
+    // takes submitted fires only, or the fire of a typed transition came
+    // without its arguments or with a token of another type
+    Rejected
+  };
+
+  // What happens to a fire that cannot fire when its queue is full
+  enum class Overflow
+  {
+    // The fire is not queued
+    Reject,
+    // The oldest queued fire of the transition makes room
+    DropOldest
+  };
+
+  // Refers to a queued fire, it can be withdrawn with PetriNet::cancel. The
+  // handle stays safe to use once the fire left the queue, cancelling does
+  // nothing then.
+  class FireHandle
+  {
+  public:
+    FireHandle() : result_(QueueResult::Rejected), transition_(-1), slot_(-1), generation_(0) {}
+
+    QueueResult result() const { return result_; }
+
+  private:
+    friend class PetriNetImpl;
+
+    FireHandle(QueueResult result, int transition = -1, int slot = -1, unsigned generation = 0)
+      : result_(result), transition_(transition), slot_(slot), generation_(generation) {}
+
+    QueueResult result_;
+    int transition_;
+    int slot_;
+    unsigned generation_;
+  };
+
+  // Where a queued fire of a transition is kept. A slot is reused once its
+  // fire leaves the queue, the generation tells the handles apart.
+  struct FireSlot
+  {
+    unsigned generation;
+    ParkedFires::Entry* queued;
+    PendingFire* pending;
+  };
+
+  // Key a token arrived with in an input place of a join transition
+  struct JoinCandidate
+  {
+    int transition;
+    JoinKey key;
+  };
+
+  // Work of a propagation pass. Kept per conflict component, components share
+  // no places so their passes can run concurrently.
+  struct PropagationState
+  {
+    std::vector<FireCandidate> searchCandidates;
+    Worklist worklist;
+    RingBuffer<PendingFire*> readyFires;
+
+    // Plan of the fire being checked or fired, queued fires take it along
+    FirePlan plan;
+
+    // Join transitions to try for a key
+    std::vector<JoinCandidate> joinCandidates;
+    JoinBindings joinBindings;
+
+    // Queued fires of the component for each token, the first of a chain
+    // through the fires. Tokenless fires are not chained.
+    FlatMap<Token*, ParkedFires::Entry*, PointerHash> queuedByToken;
+    FlatMap<Token*, PendingFire*, PointerHash> pendingByToken;
+
+    PropagationState() : queuedByToken(nullptr), pendingByToken(nullptr) {}
+  };
+
+  // Work handed to the thread owning part of the net
+  struct Submission
+  {
+    enum Type
+    {
+      QueueFire,
+      // Fire of a timed transition whose delay passed
+      DelayedFire,
+      AddToken,
+      // Token put by a fire of another shard, place is an index
+      HandOff
+    };
+
+    Submission(Type type, int place, const Fire& fire, const SharedTreePointer<Token>& token = SharedTreePointer<Token>())
+      : type(type), place(place), fire(fire), token(token) {}
+
+    Type type;
+    int place;
+    Fire fire;
+    SharedTreePointer<Token> token;
+  };
+
+  // Thread owning a set of components, fed by a lock-free queue
+  struct Shard
+  {
+    Shard() : submissions(200), drainActive(false), owner(1) {}
+
+    boost::lockfree::queue<Submission*> submissions;
+    boost::atomic<bool> drainActive;
+    WorkerPool owner;
+  };
+
   class PetriNetImpl
   {
   public:
     PetriNetImpl();
+    ~PetriNetImpl();
+    void compile();
+    void setPropagation(Propagation propagation);
+    void setScheduling(Scheduling scheduling);
+    void setParallel(int threads);
+    void setLogging(bool logging);
+    void setActionThreads(int threads);
+    void waitForActions();
+    void setShards(int shards);
+    void setDelay(int transitionId, std::chrono::milliseconds delay);
+    void setQueueLimit(int limit);
+    void setQueueLimit(int transitionId, int limit);
+    void setOverflow(Overflow overflow, const std::function<void(const Fire&)>& handler);
+    int queueDepth() const;
+    int queueDepth(int transitionId) const;
     bool canFire(const Fire& f) const;
     void fire(const Fire& f);
-    std::vector<Fire> searchNextPossibleFires(const Fire& f) const;
-    void queueFire(const Fire& f);
+    FireHandle queueFire(const Fire& f);
+    bool cancel(const FireHandle& handle);
+    int cancelFires(const SharedTreePointer<Token>& token);
+    void queueFires(const std::vector<Fire>& fires);
+    void addToken(int placeId, const SharedTreePointer<Token>& token);
+    void addTokens(int placeId, int amount);
     void reserve(int size);
 
+    // Safe to call from any thread
+    void submit(Submission* submission);
+    void submitAfter(std::chrono::milliseconds delay, Submission* submission);
+    void waitForSubmitted();
+
   private:
     friend class PetriNet;
 
-    std::map<int, int> getPlaceCounts() const;
-    std::map<int, int> getTransitionCounts() const;
+    // Hands a submission that is already counted as pending to its shard
+    void post(Submission* submission);
+    void createOwner();
+
+    void addPlace(int placeId, const Place& place);
+    void addTransition(int transitionId, const Transition& transition);
+    Place& place(int placeId);
+    const Place& place(int placeId) const;
+
+    void plan(int transition, const SharedTreePointer<Token>& token, FirePlan& plan) const;
+    const FirePlan& plan(int transition, ParkedFires::Entry* entry) const;
+    bool canFire(const FirePlan& plan) const;
+    bool hasTokens(const FirePlan& plan) const;
+    void fire(int transition, const Fire& f, const FirePlan& plan);
+    FireHandle queueFire(int transition, const Fire& f);
+    void queueSubmittedFire(const Fire& f);
+    FireHandle reject(const Fire& f);
+    FireHandle insertFire(int transition, const Fire& f, bool log);
+    int acquireSlot(int transition);
+    void releaseSlot(int transition, int slot);
+    void takeQueued(int transition, ParkedFires::Entry* entry);
+    bool makeRoom(int transition, const Fire& f);
+    bool dropOldest(int transition);
+    void propagate(int component);
+    void searchNextPossibleFires(int transition, const SharedTreePointer<Token>& token, std::vector<FireCandidate>& fires) const;
+    void addNextPossibleFires(int transition, const SharedTreePointer<Token>& token, PropagationState& state) const;
+    void addReceivingFires(int place, const SharedTreePointer<Token>& token, PropagationState& state) const;
+    void addArrivalCandidates(int place, const SharedTreePointer<Token>& token, PropagationState& state) const;
+
+    ParkedFires::Entry* findPossibleFire(int transition, Token* token);
+    void propagateSearch(PropagationState& state);
+    void propagateWorklist(PropagationState& state);
+
+    void park(int transition, const Fire& f, int slot, FirePlan& plan);
+    void unpark(PendingFire* pendingFire);
+    void discard(PendingFire* pendingFire);
+    void unindexPendingFire(PendingFire* pendingFire);
+    int findBlockingOutput(const FirePlan& plan) const;
+    void fireReadyFires(PropagationState& state);
+
+    void addJoinCandidates(int place, const SharedTreePointer<Token>& token);
+    void retryBlockedJoins(int place);
+    void planJoin(int transition, const JoinBindings& bindings, FirePlan& plan) const;
+    bool fireJoin(const JoinCandidate& candidate, PropagationState& state);
+    void fireJoins(PropagationState& state);
+
+    int shardOf(const Submission& submission) const;
+    void handleSubmissions(Shard* shard);
+    void handOff(int place, const SharedTreePointer<Token>& token, const SharedTreePointer<Token>& fireToken);
+
+    void logQueueFires(int count, int fired);
+
+    std::map<int, int> getPlaceCounts(int transition) const;
+    std::map<int, int> getTransitionCounts(int transition) const;
+
+    // Topology, densely indexed in order of creation. User ids are only
+    // translated at the API boundary, the hot path works on indices.
+    std::vector<Place> places_;
+    std::vector<Transition> transitions_;
+    std::vector<int> placeIds_;
+    std::vector<int> transitionIds_;
+    std::unordered_map<int, int> placeIndices_;
+    std::unordered_map<int, int> transitionIndices_;
+
+    // Derived by compile, indexed by place index: transitions consuming from
+    // and producing into the place
+    std::vector<std::vector<int>> consumers_;
+    std::vector<std::vector<int>> producers_;
+    // Join transitions with the place as input
+    std::vector<std::vector<int>> joinConsumers_;
+    // Join transitions and keys blocked by the capacity of the place, tried
+    // again once a token leaves it
+    std::vector<std::set<std::pair<int, JoinKey>>> blockedJoins_;
+
+    // Derived by compile: conflict component of each place and transition.
+    // Transitions sharing a place, directly or through others, are in the
+    // same component. When sharded, an unbounded place only joins the
+    // component of its consumers, its producers hand tokens off to it.
+    std::vector<int> placeComponents_;
+    std::vector<int> transitionComponents_;
+    std::deque<PropagationState> components_;
+
+    // Indexed by transition index. A deque never moves its elements, queued
+    // fires point into their own lists and pending fires are referred to by
+    // the places they depend on.
+    std::deque<ParkedFires> queuedFires_;
+    std::deque<std::list<PendingFire>> pendingFires_;
+
+    // Indexed by transition index: handle slots of the queued fires and the
+    // free ones
+    std::deque<std::vector<FireSlot>> fireSlots_;
+    std::deque<std::vector<int>> freeFireSlots_;
+
+    // Queued and pending fires of all transitions, -1 is no limit
+    boost::atomic<int> queueDepth_;
+    int queueLimit_;
+    Overflow overflow_;
+    std::function<void(const Fire&)> overflowHandler_;
+
+    Propagation propagation_;
+    Scheduling scheduling_;
+    std::unique_ptr<WorkerPool> workers_;
+    std::unique_ptr<ActionPool> actions_;
+
+    // Multi producer ingress. Without sharding a single shard owns the net,
+    // otherwise each component belongs to one shard.
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::vector<int> componentShards_;
+    bool sharded_;
+    boost::atomic<int> pendingSubmissions_;
+    std::once_flag ownerCreated_;
+    std::mutex submittedMutex_;
+    std::condition_variable submittedCv_;
+
+    // Delayed submissions wait in a timing wheel driven by the owner of the
+    // first shard
+    std::unique_ptr<TimingWheel> timers_;
+
+    bool compiled_;
+    int reserveSize_;
 
-    std::unordered_map<int, Place> places_;
-    std::unordered_map<int, Transition> transitions_;
-    std::unordered_map<int, std::unordered_multimap<Token*, Fire>> queuedFires_;
-  
     Logger logger_;
   };
 
   // TODO logging
   // TODO documentation, clean code
-  // TODO maybe queueFire with different performance strategies?
-  // TODO maybe parallel work, task based threading?
 
   class PetriNet
   {
@@ -76,30 +357,164 @@ namespace petrinet
     virtual ~PetriNet();
 
     void createPlace     (int placeId, int capacity = -1, int level = 1);
+    // Place of anonymous tokens, its marking is only a count. Arcs to it take
+    // and put tokens by number, whatever the token of the fire.
+    void createCounterPlace(int placeId, int capacity = -1);
+    // Indexes the tokens of the place by key, for the join transitions taking
+    // from it. Set before tokens arrive in the place.
+    void setPlaceKey     (int placeId, const std::function<JoinKey(const Token*)>& key);
+
+    // Freezes the topology into dense arrays. Done implicitly by the first
+    // queueFire after places or transitions were created.
+    void compile();
+
+    // Only while no fires are queued
+    void setPropagation  (Propagation propagation);
+    // Only while no fires are queued. Fires with a priority or deadline are
+    // queued with queueFires. The incremental propagation wakes fires in FIFO
+    // order and takes no other scheduling.
+    void setScheduling   (Scheduling scheduling);
+
+    // Fires of a queueFires range are split by conflict component and the
+    // components are processed on this many threads. Actions of different
+    // components then run concurrently. 0 processes them on the calling
+    // thread.
+    void setParallel     (int threads);
+
+    // Logging builds a message for every fire. Without it, the propagation
+    // does not allocate once the queues and tables have grown.
+    void setLogging      (bool logging);
+
+    // Runs transition actions on this many threads, after the fire moved the
+    // tokens. Actions on the same token keep their order. 0 runs them inline,
+    // before the tokens are moved.
+    void setActionThreads(int threads);
+    // Returns when all actions of earlier fires finished, rethrows the first
+    // exception one of them threw
+    void waitForActions  ();
   
-    void createTransition(int transitionId, const std::list<int>& inputPlaces, const std::list<int>& outputPlaces);
+    // Arcs are lists of place ids, {1, 1} takes two tokens from place 1, or
+    // weighted: {Arc{1, 2}}
+    void createTransition(int transitionId, const Arcs& inputs, const Arcs& outputs);
     template<class T>
-    void createTransition(int transitionId, const std::list<int>& inputPlaces, const std::list<int>& outputPlaces, void (T::* func)());
+    void createTransition(int transitionId, const Arcs& inputs, const Arcs& outputs, void (T::* func)());
     template<class T, typename A>
-    void createTransition(int transitionId, const std::list<int>& inputPlaces, const std::list<int>& outputPlaces, void (T::* func)(A));
+    void createTransition(int transitionId, const Arcs& inputs, const Arcs& outputs, void (T::* func)(A));
     template<class T, typename A, typename B>
-    void createTransition(int transitionId, const std::list<int>& inputPlaces, const std::list<int>& outputPlaces, void (T::* func)(A, B));
+    void createTransition(int transitionId, const Arcs& inputs, const Arcs& outputs, void (T::* func)(A, B));
     template<class T, typename A, typename B, typename C>
-    void createTransition(int transitionId, const std::list<int>& inputPlaces, const std::list<int>& outputPlaces, void (T::* func)(A, B, C));
+    void createTransition(int transitionId, const Arcs& inputs, const Arcs& outputs, void (T::* func)(A, B, C));
+
+    // Binds a member function taking any number of arguments, by value or
+    // const reference. Fires queued through the returned transition have
+    // their arguments checked at compile time, the action gets them without
+    // boost::any or dynamic_cast. A fire whose token is not a T is rejected.
+    template<class T, typename... Args>
+    TypedTransition<T, Args...> createTypedTransition(int transitionId, const Arcs& inputs, const Arcs& outputs, void (T::* func)(Args...));
+
+    // Coloured transition binding a token from each keyed input place, all
+    // with the same key, e.g. a request and its response by correlation id.
+    // It is not queued for, it fires whenever a token completes a binding.
+    // Matching is a lookup in the key index of each place. The token from
+    // the first input place goes to the outputs, the action gets all.
+    void createJoinTransition(int transitionId, const std::list<int>& inputPlaces, const Arcs& outputs,
+                              const std::function<void(const JoinBindings&)>& action = std::function<void(const JoinBindings&)>());
+
+    FireHandle queueFire (int transitionId, SharedTreePointer<Token> token, boost::any a = boost::any(), boost::any b = boost::any(), boost::any c = boost::any());
+    template<class T, typename... Args, typename... Values>
+    FireHandle queueTypedFire(const TypedTransition<T, Args...>& transition, SharedTreePointer<Token> token, Values&&... values);
+    void addToken        (int placeId,      const SharedTreePointer<Token>& token);
+    // Counter places only
+    void addTokens       (int placeId,      int amount);
+
+    // Withdraws a queued fire in O(1), false if it fired, was dropped or
+    // cancelled already. Fires of a timed transition cannot be cancelled
+    // while their delay runs.
+    bool cancel          (const FireHandle& handle);
+    // Withdraws all queued fires for the token, returns how many
+    int  cancelFires     (const SharedTreePointer<Token>& token);
+
+    // Thread-safe variants of queueFire and addToken. They are handed to a
+    // thread owning the net without taking a lock, and processed in the order
+    // each producer submitted them. The other calls must not be used while
+    // submissions are pending.
+    void submitFire      (int transitionId, SharedTreePointer<Token> token, boost::any a = boost::any(), boost::any b = boost::any(), boost::any c = boost::any());
+    template<class T, typename... Args, typename... Values>
+    void submitTypedFire (const TypedTransition<T, Args...>& transition, SharedTreePointer<Token> token, Values&&... values);
+    void submitToken     (int placeId,      SharedTreePointer<Token> token);
+    // Submits the fire once the delay passed. Pending timers are kept in a
+    // hierarchical timing wheel on the thread owning the net, adding and
+    // expiring one is O(1).
+    void submitFireAfter (std::chrono::milliseconds delay, int transitionId, SharedTreePointer<Token> token, boost::any a = boost::any(), boost::any b = boost::any(), boost::any c = boost::any());
+    // Returns when all submissions made so far are processed, delayed ones
+    // included
+    void waitForSubmitted();
+
+    // Limits the fires waiting in the net, or for one transition, -1 is no
+    // limit. A fire beyond a limit is handled by the overflow, the handler
+    // gets every fire that was rejected or dropped. Under setParallel the
+    // limit of the net is approximate.
+    void setQueueLimit   (int limit);
+    void setQueueLimit   (int transitionId, int limit);
+    void setOverflow     (Overflow overflow, std::function<void(const Fire&)> handler = std::function<void(const Fire&)>());
+    // Fires waiting in the net, or for one transition
+    int  queueDepth      () const;
+    int  queueDepth      (int transitionId) const;
 
-    void queueFire       (int transitionId, SharedTreePointer<Token> token, boost::any a = boost::any(), boost::any b = boost::any(), boost::any c = boost::any());
-    void addToken        (int placeId,      SharedTreePointer<Token> token);
+    // Timed transition: its fires are only queued once the delay passed,
+    // by the thread owning the net. Submit them with submitFire, queueFire
+    // and queueFires reject them. While one is pending the net only takes
+    // submissions, until waitForSubmitted returns.
+    void setDelay        (int transitionId, std::chrono::milliseconds delay);
 
-    const std::unordered_multiset<SharedTreePointer<Token>>& tokens(int placeId) const;
+    // Splits the net into components, cut at unbounded places, and spreads
+    // them over this many threads. Submissions go to the thread owning the
+    // transition or place, tokens put into a place of another thread are
+    // handed off to it. Use only the submit calls while sharded, after the
+    // topology is complete.
+    void setShards       (int shards);
+
+    // Queue a range of fires, or a fire of one transition for a range of
+    // tokens. Queued fires that became possible are fired in a single pass
+    // per conflict component after its fires in the range are queued.
+    template<class InputIt>
+    void queueFires      (InputIt first, InputIt last);
+    template<class InputIt>
+    void queueFires      (int transitionId, InputIt firstToken, InputIt lastToken, boost::any a = boost::any(), boost::any b = boost::any(), boost::any c = boost::any());
+
+    const Marking& tokens(int placeId) const;
+    // Tokens in the place, the only view on a counter place
+    int tokenCount(int placeId) const;
 
     void reserve(int size);
 
   private:
+    template<class T, typename... Args, typename... Values>
+    static Fire typedFire(const TypedTransition<T, Args...>& transition, const SharedTreePointer<Token>& token, Values&&... values);
+
     PetriNetImpl impl_;
   };
 
 
 
+  template<class InputIt>
+  void PetriNet::queueFires(InputIt first, InputIt last)
+  {
+    assert(impl_.pendingSubmissions_ == 0);
+    impl_.queueFires(std::vector<Fire>(first, last));
+  }
+
+  template<class InputIt>
+  void PetriNet::queueFires(int transitionId, InputIt firstToken, InputIt lastToken, boost::any a, boost::any b, boost::any c)
+  {
+    assert(impl_.pendingSubmissions_ == 0);
+    std::vector<Fire> fires;
+    for(; firstToken != lastToken; ++firstToken)
+      fires.push_back(Fire(transitionId, *firstToken, a, b, c));
+
+    impl_.queueFires(fires);
+  }
+
   template<typename T>
   void downCastAndExec(void (T::* func)(), Token* p)
   {
@@ -107,9 +522,9 @@ namespace petrinet
   }
 
   template<typename T>
-  void PetriNet::createTransition(int transitionId, const std::list<int>& inputPlaces, const std::list<int>& outputPlaces, void (T::* func)() )
+  void PetriNet::createTransition(int transitionId, const Arcs& inputs, const Arcs& outputs, void (T::* func)() )
   {
-    impl_.transitions_.insert(std::pair<int, Transition>(transitionId, Transition(inputPlaces, outputPlaces, std::bind(&downCastAndExec<T>, func, std::placeholders::_1))));
+    impl_.addTransition(transitionId, Transition(inputs, outputs, std::bind(&downCastAndExec<T>, func, std::placeholders::_1)));
   }
 
   template<typename T, typename A>
@@ -119,9 +534,9 @@ namespace petrinet
   }
 
   template<typename T, typename A>
-  void PetriNet::createTransition(int transitionId, const std::list<int>& inputPlaces, const std::list<int>& outputPlaces, void (T::* func)(A) )
+  void PetriNet::createTransition(int transitionId, const Arcs& inputs, const Arcs& outputs, void (T::* func)(A) )
   {
-    impl_.transitions_.insert(std::pair<int, Transition>(transitionId, Transition(inputPlaces, outputPlaces, std::bind(&downCastAndExec<T, A>, func, std::placeholders::_1, std::placeholders::_2))));
+    impl_.addTransition(transitionId, Transition(inputs, outputs, std::bind(&downCastAndExec<T, A>, func, std::placeholders::_1, std::placeholders::_2)));
   }
 
   template<typename T, typename A, typename B>
@@ -131,9 +546,9 @@ namespace petrinet
   }
 
   template<typename T, typename A, typename B>
-  void PetriNet::createTransition(int transitionId, const std::list<int>& inputPlaces, const std::list<int>& outputPlaces, void (T::* func)(A, B) )
+  void PetriNet::createTransition(int transitionId, const Arcs& inputs, const Arcs& outputs, void (T::* func)(A, B) )
   {
-    impl_.transitions_.insert(std::pair<int, Transition>(transitionId, Transition(inputPlaces, outputPlaces, std::bind(&downCastAndExec<T, A, B>, func, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3))));
+    impl_.addTransition(transitionId, Transition(inputs, outputs, std::bind(&downCastAndExec<T, A, B>, func, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3)));
   }
 
   template<typename T, typename A, typename B, typename C>
@@ -143,9 +558,43 @@ namespace petrinet
   }
 
   template<typename T, typename A, typename B, typename C>
-  void PetriNet::createTransition(int transitionId, const std::list<int>& inputPlaces, const std::list<int>& outputPlaces, void (T::* func)(A, B, C) )
+  void PetriNet::createTransition(int transitionId, const Arcs& inputs, const Arcs& outputs, void (T::* func)(A, B, C) )
+  {
+    impl_.addTransition(transitionId, Transition(inputs, outputs, std::bind(&downCastAndExec<T, A, B, C>, func, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4)));
+  }
+
+  template<class T, typename... Args>
+  TypedTransition<T, Args...> PetriNet::createTypedTransition(int transitionId, const Arcs& inputs, const Arcs& outputs, void (T::* func)(Args...))
+  {
+    Transition transition(inputs, outputs, std::function<void(Token*, boost::any, boost::any, boost::any)>());
+    transition.setAction(std::make_shared<MemberAction<T, Args...>>(func));
+    impl_.addTransition(transitionId, transition);
+    return TypedTransition<T, Args...>(transitionId);
+  }
+
+  template<class T, typename... Args, typename... Values>
+  Fire PetriNet::typedFire(const TypedTransition<T, Args...>& transition, const SharedTreePointer<Token>& token, Values&&... values)
+  {
+    static_assert(sizeof...(Values) == sizeof...(Args), "a typed fire takes the arguments of its transition");
+
+    // Without arguments the fire stays free of allocations
+    std::shared_ptr<const void> arguments;
+    if(sizeof...(Args))
+      arguments = std::make_shared<typename TypedTransition<T, Args...>::Arguments>(std::forward<Values>(values)...);
+    return Fire(transition.id(), token, arguments);
+  }
+
+  template<class T, typename... Args, typename... Values>
+  FireHandle PetriNet::queueTypedFire(const TypedTransition<T, Args...>& transition, SharedTreePointer<Token> token, Values&&... values)
+  {
+    assert(impl_.pendingSubmissions_ == 0);
+    return impl_.queueFire(typedFire(transition, token, std::forward<Values>(values)...));
+  }
+
+  template<class T, typename... Args, typename... Values>
+  void PetriNet::submitTypedFire(const TypedTransition<T, Args...>& transition, SharedTreePointer<Token> token, Values&&... values)
   {
-    impl_.transitions_.insert(std::pair<int, Transition>(transitionId, Transition(inputPlaces, outputPlaces, std::bind(&downCastAndExec<T, A, B, C>, func, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4))));
+    impl_.submit(new Submission(Submission::QueueFire, -1, typedFire(transition, token, std::forward<Values>(values)...)));
   }
 }
 
@@ -22,26 +22,39 @@
  **/
 
 #include "place.h"
+#include "pendingfire.h"
 
+#include <algorithm>
 #include <cassert>
 
 using namespace petrinet;
 
 Place::Place()
   :capacity_(-1),
-  level_(1)
+  level_(1),
+  counter_(false),
+  count_(0)
 {
 }
 
 Place::Place(const Place& p)
   : capacity_(p.capacity_),
-  level_(p.level_)
+  level_(p.level_),
+  counter_(p.counter_),
+  count_(p.count_),
+  tokens_(p.tokens_),
+  key_(p.key_),
+  keyIndex_(p.keyIndex_),
+  tokenWatches_(p.tokenWatches_),
+  capacityWaiters_(p.capacityWaiters_)
 {
 }
 
-Place::Place(int capacity, int level)
+Place::Place(int capacity, int level, bool counter)
   : capacity_(capacity),
-  level_(level)
+  level_(level),
+  counter_(counter),
+  count_(0)
 {}
 
 Place::~Place()
@@ -62,26 +75,164 @@ Place& Place::operator=(const Place& p)
 {
   capacity_ = p.capacity();
   level_ = p.level();
+  counter_ = p.counter_;
+  count_ = p.count_;
+  tokens_ = p.tokens_;
+  key_ = p.key_;
+  keyIndex_ = p.keyIndex_;
+  tokenWatches_ = p.tokenWatches_;
+  capacityWaiters_ = p.capacityWaiters_;
   return *this;
 }
 
 bool Place::hasCapacityLeft(int i) const
 {
   assert(capacity_ == -1 || i <= capacity_);
-  return capacity_ == -1 || capacity_ >= tokens_.size() + i;
+  return capacity_ == -1 || capacity_ >= size() + i;
 }
 
-void Place::putToken(SharedTreePointer<Token> token)
+void Place::putToken(const SharedTreePointer<Token>& token, int amount)
 {
-  assert(hasCapacityLeft());
+  assert(hasCapacityLeft(amount));
+
+  int count = tokens_.insert(token, amount);
+  if(key_ && count == amount)
+    keyIndex_.insert(std::pair<JoinKey, SharedTreePointer<Token>>(key_(token.get()), token));
+
+  if(!tokenWatches_.empty())
+  {
+    auto range = tokenWatches_.equal_range(token.get());
+    for(auto it = range.first; it != range.second; ++it)
+    {
+      if(it->second->amount > count - amount && it->second->amount <= count)
+        it->second->fire->inputSatisfied();
+    }
+  }
+}
 
-  tokens_.insert(token);
+void Place::takeToken(const SharedTreePointer<Token>& token, int amount)
+{
+  int count = tokens_.erase(token, amount);
+  if(key_ && count == 0)
+  {
+    auto range = keyIndex_.equal_range(key_(token.get()));
+    for(auto it = range.first; it != range.second; ++it)
+    {
+      if(it->second == token)
+      {
+        keyIndex_.erase(it);
+        break;
+      }
+    }
+  }
+
+  if(!tokenWatches_.empty())
+  {
+    auto range = tokenWatches_.equal_range(token.get());
+    for(auto it = range.first; it != range.second; ++it)
+    {
+      if(it->second->amount > count && it->second->amount <= count + amount)
+        it->second->fire->inputMissing();
+    }
+  }
+
+  // Every token taken makes room for a waiting fire
+  for(int i = 0; i < amount; ++i)
+    wakeWaitingFire();
 }
 
-void Place::takeToken(SharedTreePointer<Token> token)
+void Place::setKey(const std::function<JoinKey(const Token*)>& key)
 {
-  auto it = tokens_.find(token);
-  assert(it != tokens_.end());
-  tokens_.erase(it);
+  // Set up with the net, before any token arrives
+  assert(!counter_ && tokens_.empty());
+  key_ = key;
 }
 
+const SharedTreePointer<Token>* Place::find(JoinKey key) const
+{
+  auto it = keyIndex_.find(key);
+  return it != keyIndex_.end() ? &it->second : nullptr;
+}
+
+void Place::putTokens(int amount)
+{
+  assert(counter_ && hasCapacityLeft(amount));
+
+  int before = count_;
+  count_ += amount;
+
+  if(!tokenWatches_.empty())
+  {
+    auto range = tokenWatches_.equal_range(nullptr);
+    for(auto it = range.first; it != range.second; ++it)
+    {
+      if(it->second->amount > before && it->second->amount <= count_)
+        it->second->fire->inputSatisfied();
+    }
+  }
+}
+
+void Place::takeTokens(int amount)
+{
+  assert(counter_ && count_ >= amount);
+
+  int before = count_;
+  count_ -= amount;
+
+  if(!tokenWatches_.empty())
+  {
+    auto range = tokenWatches_.equal_range(nullptr);
+    for(auto it = range.first; it != range.second; ++it)
+    {
+      if(it->second->amount > count_ && it->second->amount <= before)
+        it->second->fire->inputMissing();
+    }
+  }
+
+  // Every token taken makes room for a waiting fire
+  for(int i = 0; i < amount; ++i)
+    wakeWaitingFire();
+}
+
+void Place::watch(FireDependency* dependency)
+{
+  tokenWatches_.insert(std::pair<Token*, FireDependency*>(dependency->token, dependency));
+}
+
+void Place::unwatch(FireDependency* dependency)
+{
+  auto range = tokenWatches_.equal_range(dependency->token);
+  for(auto it = range.first; it != range.second; ++it)
+  {
+    if(it->second == dependency)
+    {
+      tokenWatches_.erase(it);
+      return;
+    }
+  }
+  assert(false);
+}
+
+void Place::waitForCapacity(PendingFire* pendingFire, bool first)
+{
+  if(first)
+    capacityWaiters_.push_front(pendingFire);
+  else
+    capacityWaiters_.push_back(pendingFire);
+}
+
+void Place::stopWaiting(PendingFire* pendingFire)
+{
+  capacityWaiters_.erase(std::find(capacityWaiters_.begin(), capacityWaiters_.end(), pendingFire));
+}
+
+void Place::wakeWaitingFire()
+{
+  while(!capacityWaiters_.empty())
+  {
+    PendingFire* pendingFire = capacityWaiters_.front();
+    capacityWaiters_.pop_front();
+    if(pendingFire->capacityAvailable())
+      return;
+  }
+}
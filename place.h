@@ -24,21 +24,29 @@
 #ifndef PETRINET_PLACE_H
 #define PETRINET_PLACE_H
 
-#include <unordered_set>
+#include <deque>
+#include <functional>
+#include <unordered_map>
 
+#include "marking.h"
 #include "sharedtreepointer.h"
 
 namespace petrinet
 {
 
+  struct FireDependency;
+  class PendingFire;
   class Token;
 
+  // Value tokens are matched on by join transitions, e.g. a correlation id
+  typedef long long JoinKey;
+
   class Place
   {
   public:
     Place();
     Place(const Place& p);
-    Place(int capacity, int level = 1);
+    Place(int capacity, int level = 1, bool counter = false);
     virtual ~Place();
 
     Place& operator=(const Place& p);
@@ -46,17 +54,52 @@ namespace petrinet
     int capacity() const;
     int level() const;
 
+    // Holds anonymous tokens, only their number is kept
+    bool counter() const { return counter_; }
+    // Tokens held, for either kind of place
+    int size() const { return counter_ ? count_ : tokens_.size(); }
+
     bool hasCapacityLeft(int i = 1) const;
 
-    const std::unordered_multiset<SharedTreePointer<Token>>& tokens() const { return tokens_; }
+    const Marking& tokens() const { return tokens_; }
+
+    // Indexes the tokens by key, join transitions find theirs without a scan
+    void setKey(const std::function<JoinKey(const Token*)>& key);
+    bool keyed() const { return (bool) key_; }
+    JoinKey key(const Token* token) const { return key_(token); }
+    // A token with the key, null if there is none
+    const SharedTreePointer<Token>* find(JoinKey key) const;
+
+    // Amount copies of the token at once
+    void putToken (const SharedTreePointer<Token>& token, int amount = 1);
+    void takeToken(const SharedTreePointer<Token>& token, int amount = 1);
 
-    void putToken (SharedTreePointer<Token> token);
-    void takeToken(SharedTreePointer<Token> token);
+    // Counter places only
+    void putTokens (int amount);
+    void takeTokens(int amount);
+
+    // Pending fires depending on this place, updated by putToken and takeToken.
+    // Dependencies on a counter place have no token.
+    void watch  (FireDependency* dependency);
+    void unwatch(FireDependency* dependency);
+
+    // Ready fires blocked by the capacity of this place, woken in order, one
+    // for every token taken
+    void waitForCapacity(PendingFire* pendingFire, bool first);
+    void stopWaiting(PendingFire* pendingFire);
+    void wakeWaitingFire();
 
   private:
     int capacity_;
     int level_;
-    std::unordered_multiset<SharedTreePointer<Token>> tokens_;
+    bool counter_;
+    int count_;
+    Marking tokens_;
+    std::function<JoinKey(const Token*)> key_;
+    std::unordered_multimap<JoinKey, SharedTreePointer<Token>> keyIndex_;
+
+    std::unordered_multimap<Token*, FireDependency*> tokenWatches_;
+    std::deque<PendingFire*> capacityWaiters_;
   };
 }
 
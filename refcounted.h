@@ -0,0 +1,113 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+#ifndef PETRINET_REFCOUNTED_H
+#define PETRINET_REFCOUNTED_H
+
+#include <boost/atomic.hpp>
+
+namespace petrinet
+{
+
+  // Reference count kept in the root of a token tree, shared by all pointers
+  // into the tree. The count is atomic unless the tree is confined to one
+  // thread, then it is updated with plain loads and stores.
+  class RefCounted
+  {
+  public:
+    RefCounted();
+    // A copy is a new object, nothing refers to it yet
+    RefCounted(const RefCounted& other);
+    RefCounted& operator=(const RefCounted& other);
+    virtual ~RefCounted();
+
+    // Set before the object is shared. Nets with action threads or logging
+    // copy fires to other threads, their tokens need the atomic count.
+    void setSingleThreaded(bool singleThreaded) { singleThreaded_ = singleThreaded; }
+    bool singleThreaded() const { return singleThreaded_; }
+
+    void retain() const;
+    // Destroys the object when the last reference goes
+    void release() const;
+    int references() const { return references_.load(boost::memory_order_relaxed); }
+
+  protected:
+    // Deletes by default, objects that do not own their memory override it
+    virtual void destroy() const;
+
+  private:
+    mutable boost::atomic<int> references_;
+    bool singleThreaded_;
+  };
+
+  inline RefCounted::RefCounted()
+    : references_(0),
+    singleThreaded_(false)
+  {
+  }
+
+  inline RefCounted::RefCounted(const RefCounted& other)
+    : references_(0),
+    singleThreaded_(other.singleThreaded_)
+  {
+  }
+
+  inline RefCounted& RefCounted::operator=(const RefCounted&)
+  {
+    return *this;
+  }
+
+  inline RefCounted::~RefCounted()
+  {
+  }
+
+  inline void RefCounted::retain() const
+  {
+    if(singleThreaded_)
+      references_.store(references_.load(boost::memory_order_relaxed) + 1, boost::memory_order_relaxed);
+    else
+      references_.fetch_add(1, boost::memory_order_relaxed);
+  }
+
+  inline void RefCounted::release() const
+  {
+    int left;
+    if(singleThreaded_)
+    {
+      left = references_.load(boost::memory_order_relaxed) - 1;
+      references_.store(left, boost::memory_order_relaxed);
+    }
+    else
+      left = references_.fetch_sub(1, boost::memory_order_acq_rel) - 1;
+
+    if(left == 0)
+      destroy();
+  }
+
+  inline void RefCounted::destroy() const
+  {
+    delete this;
+  }
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,103 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+#ifndef PETRINET_RINGBUFFER_H
+#define PETRINET_RINGBUFFER_H
+
+#include <cassert>
+#include <vector>
+
+namespace petrinet
+{
+
+  // FIFO in a growing circular buffer. Unlike a deque it keeps its storage
+  // when it runs empty, a queue that is filled and drained over and over
+  // stops allocating once it reached its largest size.
+  template<class T>
+  class RingBuffer
+  {
+  public:
+    RingBuffer();
+
+    bool empty() const { return size_ == 0; }
+    int size() const { return size_; }
+
+    T& front() { assert(size_); return items_[head_]; }
+    void push_back(const T& item);
+    void pop_front();
+    void clear();
+
+  private:
+    void grow();
+
+    // Power of two
+    std::vector<T> items_;
+    int head_;
+    int size_;
+  };
+
+  template<class T>
+  RingBuffer<T>::RingBuffer()
+    : head_(0),
+    size_(0)
+  {
+  }
+
+  template<class T>
+  void RingBuffer<T>::push_back(const T& item)
+  {
+    if(size_ == (int)items_.size())
+      grow();
+    items_[(head_ + size_++) & (items_.size() - 1)] = item;
+  }
+
+  template<class T>
+  void RingBuffer<T>::pop_front()
+  {
+    assert(size_);
+    // Releases what the item holds
+    items_[head_] = T();
+    head_ = (head_ + 1) & (items_.size() - 1);
+    --size_;
+  }
+
+  template<class T>
+  void RingBuffer<T>::clear()
+  {
+    while(size_)
+      pop_front();
+    head_ = 0;
+  }
+
+  template<class T>
+  void RingBuffer<T>::grow()
+  {
+    std::vector<T> items(items_.empty() ? 16 : 2 * items_.size());
+    for(int i = 0; i < size_; ++i)
+      items[i] = items_[(head_ + i) & (items_.size() - 1)];
+    items_.swap(items);
+    head_ = 0;
+  }
+}
+
+#endif
\ No newline at end of file
@@ -24,13 +24,91 @@
 #ifndef PETRINET_SHAREDTREEPOINTER_H
 #define PETRINET_SHAREDTREEPOINTER_H
 
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <iterator>
 #include <list>
 #include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "refcounted.h"
 
 namespace petrinet
 {
 
+  // Allocations are aligned, the low bits of a pointer are always zero and
+  // the high ones rarely differ. Mixes all bits into the low ones, which
+  // power of two tables index with.
+  inline std::size_t hashPointer(const void* p)
+  {
+    std::uint64_t h = reinterpret_cast<std::uintptr_t>(p);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (std::size_t) h;
+  }
+
+  struct PointerHash
+  {
+    std::size_t operator()(const void* p) const { return hashPointer(p); }
+  };
+
+  // Keeps a tree alive. Trees of RefCounted tokens count in their root, other
+  // trees are held by a shared_ptr.
+  template<class T, bool Intrusive = std::is_base_of<RefCounted, T>::value>
+  class TreeOwner
+  {
+  public:
+    TreeOwner() {}
+    explicit TreeOwner(T* root) : root_(root) {}
+
+    long use_count() const { return root_.use_count(); }
+
+  private:
+    std::shared_ptr<T> root_;
+  };
+
+  template<class T>
+  class TreeOwner<T, true>
+  {
+  public:
+    TreeOwner() : root_(nullptr) {}
+    explicit TreeOwner(T* root) : root_(root) { if(root_) root_->retain(); }
+    TreeOwner(const TreeOwner& other) : root_(other.root_) { if(root_) root_->retain(); }
+    TreeOwner(TreeOwner&& other) : root_(other.root_) { other.root_ = nullptr; }
+    ~TreeOwner() { if(root_) root_->release(); }
+
+    TreeOwner& operator=(const TreeOwner& other)
+    {
+      if(other.root_)
+        other.root_->retain();
+      if(root_)
+        root_->release();
+      root_ = other.root_;
+      return *this;
+    }
+
+    TreeOwner& operator=(TreeOwner&& other)
+    {
+      if(this != &other)
+      {
+        if(root_)
+          root_->release();
+        root_ = other.root_;
+        other.root_ = nullptr;
+      }
+      return *this;
+    }
+
+    long use_count() const { return root_ ? root_->references() : 0; }
+
+  private:
+    const RefCounted* root_;
+  };
+
   template<class T>
   class SharedTreePointer
   {
@@ -39,9 +117,11 @@ namespace petrinet
     SharedTreePointer(T* root);
     SharedTreePointer(T* ptr, T* root, int level);
     SharedTreePointer(const SharedTreePointer<T>& other);
+    SharedTreePointer(SharedTreePointer<T>&& other);
     ~SharedTreePointer();
 
     SharedTreePointer<T>& operator=(const SharedTreePointer<T>& other);
+    SharedTreePointer<T>& operator=(SharedTreePointer<T>&& other);
     bool operator==(const SharedTreePointer<T>& other) const;
     T& operator*() const;
     T* operator->() const;
@@ -81,10 +161,52 @@ namespace petrinet
     iterator end() const;
     iterator end(int level) const;
 
+    // Visits only the tokens at one level of the tree, depth first from left
+    // to right, which is their level order. The path is kept in a fixed
+    // stack, starting takes a walk down and nothing is allocated unless the
+    // level lies deeper than the stack.
+    class level_iterator : public std::iterator<std::forward_iterator_tag, SharedTreePointer<T>>
+    {
+      friend class SharedTreePointer<T>;
+      public:
+        level_iterator();
+        level_iterator& operator++();
+        const SharedTreePointer<T>& operator*() const;
+        const SharedTreePointer<T>* operator->() const;
+        bool operator==(const level_iterator& other) const;
+        bool operator!=(const level_iterator& other) const;
+
+        static const int inlineDepth = 16;
+
+      private:
+        struct Step
+        {
+          T* node;
+          int index;
+        };
+
+        level_iterator(const SharedTreePointer<T>& from, int depth);
+        // Next token at the depth, continuing with child index of the node one up
+        void seek(int depth, int index);
+        Step* path();
+
+        // Holds the tree, only its pointer moves
+        SharedTreePointer<T> current_;
+        int depth_;
+        Step path_[inlineDepth + 1];
+        // Used instead of path_ for levels deeper than inlineDepth
+        std::vector<Step> deepPath_;
+    };
+
+    level_iterator levelBegin(int level) const;
+    level_iterator levelEnd() const;
+    // Number of tokens at a level of the tree below this one
+    int levelSize(int level) const;
+
   private:
-    SharedTreePointer(T* ptr, std::shared_ptr<T> root, int level);
+    SharedTreePointer(T* ptr, const TreeOwner<T>& owner, int level);
 
-    std::shared_ptr<T> root_;
+    TreeOwner<T> owner_;
     T* ptr_;
     int level_;
   };
@@ -98,34 +220,44 @@ namespace petrinet
 
   template<class T>
   SharedTreePointer<T>::SharedTreePointer(T* root)
-    : ptr_(root),
-    root_(root),
+    : owner_(root),
+    ptr_(root),
     level_(1)
   {
   }
 
   template<class T>
   SharedTreePointer<T>::SharedTreePointer(T* ptr, T* root, int level)
-    : ptr_(ptr),
-    root_(root),
+    : owner_(root),
+    ptr_(ptr),
     level_(level)
   {
   }
 
   template<class T>
-  SharedTreePointer<T>::SharedTreePointer(T* ptr, std::shared_ptr<T> root, int level)
-    : ptr_(ptr),
-    root_(root),
+  SharedTreePointer<T>::SharedTreePointer(T* ptr, const TreeOwner<T>& owner, int level)
+    : owner_(owner),
+    ptr_(ptr),
     level_(level)
   {
   }
 
   template<class T>
   SharedTreePointer<T>::SharedTreePointer(const SharedTreePointer& other)
-    : ptr_(other.ptr_),
-    root_(other.root_),
+    : owner_(other.owner_),
+    ptr_(other.ptr_),
+    level_(other.level_)
+  {
+  }
+
+  template<class T>
+  SharedTreePointer<T>::SharedTreePointer(SharedTreePointer&& other)
+    : owner_(std::move(other.owner_)),
+    ptr_(other.ptr_),
     level_(other.level_)
   {
+    other.ptr_ = 0;
+    other.level_ = -1;
   }
 
   template<class T>
@@ -136,9 +268,23 @@ namespace petrinet
   template<class T>
   SharedTreePointer<T>& SharedTreePointer<T>::operator=(const SharedTreePointer<T>& other)
   {
+    owner_ = other.owner_;
+    ptr_ = other.ptr_;
+    level_ = other.level_;
+    return *this;
+  }
+
+  template<class T>
+  SharedTreePointer<T>& SharedTreePointer<T>::operator=(SharedTreePointer<T>&& other)
+  {
+    owner_ = std::move(other.owner_);
     ptr_ = other.ptr_;
-    root_ = other.root_;
     level_ = other.level_;
+    if(this != &other)
+    {
+      other.ptr_ = 0;
+      other.level_ = -1;
+    }
     return *this;
   }
 
@@ -163,12 +309,13 @@ namespace petrinet
   template<class T>
   bool SharedTreePointer<T>::unique() const
   {
-    return root_.unique();
+    return owner_.use_count() == 1;
   }
 
   template<class T>
   long SharedTreePointer<T>::use_count() const
   {
+    return owner_.use_count();
   }
 
   template<class T>
@@ -187,7 +334,7 @@ namespace petrinet
   template<class T>
   SharedTreePointer<T> SharedTreePointer<T>::child(int i) const
   {
-    return SharedTreePointer<T>(dynamic_cast<T*>(ptr_->child(i)), root_, level() + 1);
+    return SharedTreePointer<T>(dynamic_cast<T*>(ptr_->child(i)), owner_, level() + 1);
   }
 
   template<class T>
@@ -216,6 +363,25 @@ namespace petrinet
     return iter;
   }
 
+  template<class T>
+  typename SharedTreePointer<T>::level_iterator SharedTreePointer<T>::levelBegin(int lvl) const
+  {
+    assert(lvl >= level());
+    return SharedTreePointer<T>::level_iterator(*this, lvl - level());
+  }
+
+  template<class T>
+  typename SharedTreePointer<T>::level_iterator SharedTreePointer<T>::levelEnd() const
+  {
+    return SharedTreePointer<T>::level_iterator();
+  }
+
+  template<class T>
+  int SharedTreePointer<T>::levelSize(int lvl) const
+  {
+    return lvl == level() ? 1 : ptr_->descendants(lvl - level());
+  }
+
   template<class T>
   typename SharedTreePointer<T>::iterator SharedTreePointer<T>::end() const
   {
@@ -249,7 +415,7 @@ namespace std
   {
     std::size_t operator()(const petrinet::SharedTreePointer<T>& s) const
     {
-      return (std::size_t) s.get();
+      return petrinet::hashPointer(s.get());
     }
   };
 };
@@ -326,6 +492,95 @@ namespace petrinet
   {
     return current_;
   }
+
+  template<class T>
+  SharedTreePointer<T>::level_iterator::level_iterator()
+    : depth_(0),
+    path_()
+  {
+  }
+
+  template<class T>
+  SharedTreePointer<T>::level_iterator::level_iterator(const SharedTreePointer<T>& from, int depth)
+    : current_(from.get(), from.owner_, from.level() + depth),
+    depth_(depth),
+    path_()
+  {
+    if(depth_ > inlineDepth)
+      deepPath_.resize(depth_ + 1);
+    if(depth_ > 0)
+    {
+      path()[0].node = from.get();
+      seek(1, 0);
+    }
+  }
+
+  template<class T>
+  typename SharedTreePointer<T>::level_iterator::Step* SharedTreePointer<T>::level_iterator::path()
+  {
+    return deepPath_.empty() ? path_ : deepPath_.data();
+  }
+
+  template<class T>
+  void SharedTreePointer<T>::level_iterator::seek(int depth, int index)
+  {
+    Step* path = this->path();
+    while(depth > 0)
+    {
+      T* parent = path[depth - 1].node;
+      if(index < parent->size())
+      {
+        path[depth].node = dynamic_cast<T*>(parent->child(index));
+        path[depth].index = index;
+        if(depth == depth_)
+        {
+          current_.ptr_ = path[depth].node;
+          return;
+        }
+        ++depth;
+        index = 0;
+      }
+      // Subtree done, on to the next sibling of the parent
+      else if(--depth > 0)
+        index = path[depth].index + 1;
+    }
+
+    current_ = SharedTreePointer<T>();
+  }
+
+  template<class T>
+  typename SharedTreePointer<T>::level_iterator& SharedTreePointer<T>::level_iterator::operator++()
+  {
+    if(depth_ == 0)
+      current_ = SharedTreePointer<T>();
+    else
+      seek(depth_, path()[depth_].index + 1);
+    return *this;
+  }
+
+  template<class T>
+  const SharedTreePointer<T>& SharedTreePointer<T>::level_iterator::operator*() const
+  {
+    return current_;
+  }
+
+  template<class T>
+  const SharedTreePointer<T>* SharedTreePointer<T>::level_iterator::operator->() const
+  {
+    return &current_;
+  }
+
+  template<class T>
+  bool SharedTreePointer<T>::level_iterator::operator==(const level_iterator& other) const
+  {
+    return current_ == other.current_;
+  }
+
+  template<class T>
+  bool SharedTreePointer<T>::level_iterator::operator!=(const level_iterator& other) const
+  {
+    return !(*this == other);
+  }
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,403 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+
+#ifndef PETRINET_STATICNET_H
+#define PETRINET_STATICNET_H
+
+#include <array>
+#include <cassert>
+#include <tuple>
+#include <utility>
+
+#include "sharedtreepointer.h"
+#include "token.h"
+
+namespace petrinet
+{
+
+  // A net whose topology is fixed at build time, declared as types:
+  //
+  //   typedef StaticNet<
+  //     StaticPlaces<StaticPlace<1, 16>, StaticCounterPlace<2>>,
+  //     StaticTransitions<StaticTransition<1, StaticInputs<StaticArc<1>>, StaticOutputs<StaticArc<2, 3>>>>
+  //   > Net;
+  //
+  // Places and transitions are looked up by id at compile time, the arcs of a
+  // transition are unrolled into straight code and the marking of each place
+  // has a fixed size. There is no queueing or propagation, canFire and fire
+  // work on the tokens of the net as they are.
+
+  // Holds at most Capacity tokens of the given level in a fixed array
+  template<int Id, int Capacity, int Level = 1>
+  struct StaticPlace
+  {
+    static_assert(Capacity > 0, "A static place has a fixed capacity");
+    enum { id = Id, capacity = Capacity, level = Level, counter = 0 };
+  };
+
+  // Only holds a number of anonymous tokens
+  template<int Id, int Capacity = -1>
+  struct StaticCounterPlace
+  {
+    enum { id = Id, capacity = Capacity, level = -1, counter = 1 };
+  };
+
+  template<int PlaceId, int Weight = 1>
+  struct StaticArc
+  {
+    static_assert(Weight > 0, "An arc moves at least one token");
+    enum { place = PlaceId, weight = Weight };
+  };
+
+  template<class... Arcs> struct StaticInputs {};
+  template<class... Arcs> struct StaticOutputs {};
+
+  struct StaticNoAction
+  {
+    void operator()(Token*) const {}
+  };
+
+  // Action is default constructed and called with the token of each fire
+  template<int Id, class Inputs, class Outputs, class Action = StaticNoAction>
+  struct StaticTransition;
+
+  template<int Id, class... Inputs, class... Outputs, class Action>
+  struct StaticTransition<Id, StaticInputs<Inputs...>, StaticOutputs<Outputs...>, Action>
+  {
+    enum { id = Id };
+  };
+
+  template<class... Places> struct StaticPlaces {};
+  template<class... Transitions> struct StaticTransitions {};
+
+  // Position of the element with the id, the number of elements if there is none
+  template<int Id, class... Elements>
+  struct StaticIndexOf;
+
+  template<int Id>
+  struct StaticIndexOf<Id>
+  {
+    enum { value = 0 };
+  };
+
+  template<int Id, class First, class... Rest>
+  struct StaticIndexOf<Id, First, Rest...>
+  {
+    enum { value = First::id == Id ? 0 : 1 + StaticIndexOf<Id, Rest...>::value };
+  };
+
+  // Whether the place has one of the arcs
+  template<int PlaceId, class... Arcs>
+  struct StaticHasArc;
+
+  template<int PlaceId>
+  struct StaticHasArc<PlaceId>
+  {
+    enum { value = 0 };
+  };
+
+  template<int PlaceId, class First, class... Rest>
+  struct StaticHasArc<PlaceId, First, Rest...>
+  {
+    enum { value = First::place == PlaceId || StaticHasArc<PlaceId, Rest...>::value };
+  };
+
+  // Whether no place has more than one of the arcs
+  template<class... Arcs>
+  struct StaticDistinctArcs;
+
+  template<>
+  struct StaticDistinctArcs<>
+  {
+    enum { value = 1 };
+  };
+
+  template<class First, class... Rest>
+  struct StaticDistinctArcs<First, Rest...>
+  {
+    enum { value = !StaticHasArc<First::place, Rest...>::value && StaticDistinctArcs<Rest...>::value };
+  };
+
+  // Marking of a place. The tokens are kept in an array with their
+  // multiplicity and found by a scan, static places are small.
+  template<class Place, bool Counter = Place::counter>
+  class StaticMarking
+  {
+    struct Slot
+    {
+      SharedTreePointer<Token> token;
+      int count;
+    };
+
+  public:
+    StaticMarking() : used_(0), size_(0) {}
+
+    int size() const { return size_; }
+
+    int count(const SharedTreePointer<Token>& token) const
+    {
+      int i = find(token);
+      return i == used_ ? 0 : slots_[i].count;
+    }
+
+    // Weight copies of each token at the level of the place
+    bool canTake(const SharedTreePointer<Token>& token, int weight) const
+    {
+      if(token.level() == Place::level)
+        return count(token) >= weight;
+
+      for(auto it = token.levelBegin(Place::level); it != token.levelEnd(); ++it)
+      {
+        if(count(*it) < weight)
+          return false;
+      }
+      return true;
+    }
+
+    bool canPut(const SharedTreePointer<Token>& token, int weight) const
+    {
+      return size_ + token.levelSize(Place::level) * weight <= Place::capacity;
+    }
+
+    void take(const SharedTreePointer<Token>& token, int weight)
+    {
+      if(token.level() == Place::level)
+        erase(token, weight);
+      else
+      {
+        for(auto it = token.levelBegin(Place::level); it != token.levelEnd(); ++it)
+          erase(*it, weight);
+      }
+    }
+
+    void put(const SharedTreePointer<Token>& token, int weight)
+    {
+      if(token.level() == Place::level)
+        insert(token, weight);
+      else
+      {
+        for(auto it = token.levelBegin(Place::level); it != token.levelEnd(); ++it)
+          insert(*it, weight);
+      }
+    }
+
+  private:
+    int find(const SharedTreePointer<Token>& token) const
+    {
+      int i = 0;
+      while(i < used_ && slots_[i].token.get() != token.get())
+        ++i;
+      return i;
+    }
+
+    void insert(const SharedTreePointer<Token>& token, int amount)
+    {
+      assert(size_ + amount <= Place::capacity);
+      int i = find(token);
+      if(i == used_)
+      {
+        slots_[used_].token = token;
+        slots_[used_++].count = 0;
+      }
+      slots_[i].count += amount;
+      size_ += amount;
+    }
+
+    void erase(const SharedTreePointer<Token>& token, int amount)
+    {
+      int i = find(token);
+      assert(i < used_ && slots_[i].count >= amount);
+      size_ -= amount;
+      if((slots_[i].count -= amount) > 0)
+        return;
+
+      // The last token takes the freed slot, which lets go of its reference
+      slots_[i] = std::move(slots_[--used_]);
+      slots_[used_].token = SharedTreePointer<Token>();
+    }
+
+    std::array<Slot, Place::capacity> slots_;
+    int used_;
+    int size_;
+  };
+
+  template<class Place>
+  class StaticMarking<Place, true>
+  {
+  public:
+    StaticMarking() : size_(0) {}
+
+    int size() const { return size_; }
+
+    bool canTake(const SharedTreePointer<Token>&, int weight) const { return size_ >= weight; }
+    bool canPut(const SharedTreePointer<Token>&, int weight) const { return Place::capacity == -1 || size_ + weight <= Place::capacity; }
+    void take(const SharedTreePointer<Token>&, int weight) { size_ -= weight; }
+    void put(const SharedTreePointer<Token>&, int weight) { size_ += weight; }
+
+  private:
+    int size_;
+  };
+
+  template<class Places, class Transitions>
+  class StaticNet;
+
+  // The arcs of a transition, one call each, resolved at compile time
+  template<class Net, class... Arcs>
+  struct StaticSteps;
+
+  template<class Net>
+  struct StaticSteps<Net>
+  {
+    static bool canTake(const Net&, const SharedTreePointer<Token>&) { return true; }
+    static bool canPut(const Net&, const SharedTreePointer<Token>&) { return true; }
+    static void take(Net&, const SharedTreePointer<Token>&) {}
+    static void put(Net&, const SharedTreePointer<Token>&) {}
+  };
+
+  template<class Net, class Arc, class... Rest>
+  struct StaticSteps<Net, Arc, Rest...>
+  {
+    static bool canTake(const Net& net, const SharedTreePointer<Token>& token)
+    {
+      return net.template marking<Arc::place>().canTake(token, Arc::weight) && StaticSteps<Net, Rest...>::canTake(net, token);
+    }
+
+    static bool canPut(const Net& net, const SharedTreePointer<Token>& token)
+    {
+      return net.template marking<Arc::place>().canPut(token, Arc::weight) && StaticSteps<Net, Rest...>::canPut(net, token);
+    }
+
+    static void take(Net& net, const SharedTreePointer<Token>& token)
+    {
+      net.template marking<Arc::place>().take(token, Arc::weight);
+      StaticSteps<Net, Rest...>::take(net, token);
+    }
+
+    static void put(Net& net, const SharedTreePointer<Token>& token)
+    {
+      net.template marking<Arc::place>().put(token, Arc::weight);
+      StaticSteps<Net, Rest...>::put(net, token);
+    }
+  };
+
+  template<class Net, class Transition>
+  struct StaticFire;
+
+  template<class Net, int Id, class... Inputs, class... Outputs, class Action>
+  struct StaticFire<Net, StaticTransition<Id, StaticInputs<Inputs...>, StaticOutputs<Outputs...>, Action>>
+  {
+    // Repeated places would each be checked against the tokens of the place
+    // on their own
+    static_assert(StaticDistinctArcs<Inputs...>::value && StaticDistinctArcs<Outputs...>::value,
+                  "Give a place one arc with the summed weight");
+
+    static bool canFire(const Net& net, const SharedTreePointer<Token>& token)
+    {
+      return StaticSteps<Net, Inputs...>::canTake(net, token) && StaticSteps<Net, Outputs...>::canPut(net, token);
+    }
+
+    static void fire(Net& net, const SharedTreePointer<Token>& token)
+    {
+      Action()(token.get());
+      StaticSteps<Net, Inputs...>::take(net, token);
+      StaticSteps<Net, Outputs...>::put(net, token);
+    }
+  };
+
+  template<class... Places, class... Transitions>
+  class StaticNet<StaticPlaces<Places...>, StaticTransitions<Transitions...>>
+  {
+    template<class Net, class... Arcs> friend struct StaticSteps;
+
+    template<int PlaceId>
+    struct PlaceOf
+    {
+      enum { index = StaticIndexOf<PlaceId, Places...>::value };
+      static_assert(index < sizeof...(Places), "No place with the id");
+      typedef typename std::tuple_element<index, std::tuple<Places...>>::type type;
+    };
+
+    template<int TransitionId>
+    struct TransitionOf
+    {
+      enum { index = StaticIndexOf<TransitionId, Transitions...>::value };
+      static_assert(index < sizeof...(Transitions), "No transition with the id");
+      typedef StaticFire<StaticNet, typename std::tuple_element<index, std::tuple<Transitions...>>::type> type;
+    };
+
+  public:
+    // Asserts there is capacity left
+    template<int PlaceId>
+    void addToken(const SharedTreePointer<Token>& token)
+    {
+      assert(marking<PlaceId>().canPut(token, 1));
+      marking<PlaceId>().put(token, 1);
+    }
+
+    template<int PlaceId>
+    void addTokens(int amount)
+    {
+      static_assert(PlaceOf<PlaceId>::type::counter, "Anonymous tokens only go to a counter place");
+      assert(marking<PlaceId>().canPut(SharedTreePointer<Token>(), amount));
+      marking<PlaceId>().put(SharedTreePointer<Token>(), amount);
+    }
+
+    template<int PlaceId>
+    int tokenCount() const { return marking<PlaceId>().size(); }
+
+    template<int PlaceId>
+    int count(const SharedTreePointer<Token>& token) const { return marking<PlaceId>().count(token); }
+
+    template<int TransitionId>
+    bool canFire(const SharedTreePointer<Token>& token) const
+    {
+      return TransitionOf<TransitionId>::type::canFire(*this, token);
+    }
+
+    // Calls the action and moves the tokens, canFire has to hold
+    template<int TransitionId>
+    void fire(const SharedTreePointer<Token>& token)
+    {
+      assert(canFire<TransitionId>(token));
+      TransitionOf<TransitionId>::type::fire(*this, token);
+    }
+
+  private:
+    template<int PlaceId>
+    StaticMarking<typename PlaceOf<PlaceId>::type>& marking()
+    {
+      return std::get<PlaceOf<PlaceId>::index>(markings_);
+    }
+
+    template<int PlaceId>
+    const StaticMarking<typename PlaceOf<PlaceId>::type>& marking() const
+    {
+      return std::get<PlaceOf<PlaceId>::index>(markings_);
+    }
+
+    std::tuple<StaticMarking<Places>...> markings_;
+  };
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,66 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include "flatmap.h"
+#include "sharedtreepointer.h"
+
+using namespace petrinet;
+
+BOOST_AUTO_TEST_CASE(testFlatMapEraseKeepsProbing)
+{
+  // Keys spaced by the alignment of allocations, with a weak hash they would
+  // all collide. Erasing every other one moves the rest of their probe
+  // sequences back.
+  std::vector<int> storage(4096);
+  FlatMap<const int*, int, PointerHash> map(nullptr);
+  for(int i = 0; i < 4096; i += 4)
+    BOOST_TEST(map.insert(&storage[i], i).second);
+  BOOST_TEST(!map.insert(&storage[0], -1).second);
+  BOOST_TEST(map.size() == 1024);
+
+  for(int i = 0; i < 4096; i += 8)
+    BOOST_TEST(map.erase(&storage[i]));
+  BOOST_TEST(!map.erase(&storage[0]));
+  BOOST_TEST(map.size() == 512);
+
+  for(int i = 0; i < 4096; i += 4)
+  {
+    const int* value = map.find(&storage[i]);
+    if(i % 8)
+      BOOST_TEST((value && *value == i));
+    else
+      BOOST_TEST(!value);
+  }
+
+  // Iterating skips the free slots
+  int visited = 0;
+  for(auto it = map.begin(); it != map.end(); ++it, ++visited)
+    BOOST_TEST((it->first == &storage[it->second] && it->second % 8));
+  BOOST_TEST(visited == 512);
+
+  map.clear();
+  BOOST_TEST(map.empty());
+  BOOST_TEST(!map.find(&storage[4]));
+}
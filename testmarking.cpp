@@ -0,0 +1,83 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include "algorithm.h"
+#include "marking.h"
+#include "token.h"
+
+using namespace petrinet;
+
+BOOST_AUTO_TEST_CASE(testMarkingMultiplicity)
+{
+  Marking marking;
+  SharedTreePointer<Token> token(new Token());
+  SharedTreePointer<Token> other(new Token());
+
+  BOOST_TEST(marking.insert(token) == 1);
+  BOOST_TEST(marking.insert(token) == 2);
+  BOOST_TEST(marking.insert(other) == 1);
+  BOOST_TEST(marking.size() == 3);
+  BOOST_TEST(marking.distinct() == 2);
+  BOOST_TEST(marking.count(token) == 2);
+  BOOST_TEST(count(marking, token) == 2);
+  BOOST_TEST(contains(marking, other));
+
+  BOOST_TEST(marking.erase(token) == 1);
+  BOOST_TEST(marking.erase(other) == 0);
+  BOOST_TEST(!contains(marking, other));
+  BOOST_TEST(marking.count(other) == 0);
+  BOOST_TEST(marking.size() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(testMarkingGrowAndErase)
+{
+  // Enough tokens to rehash several times and collide in the table, erasing
+  // every other one shifts the probe sequences back
+  Marking marking;
+  std::vector<SharedTreePointer<Token>> tokens;
+  for(int i = 0; i < 1000; ++i)
+  {
+    tokens.push_back(SharedTreePointer<Token>(new Token()));
+    marking.insert(tokens.back());
+    if(i % 3 == 0)
+      marking.insert(tokens.back());
+  }
+
+  for(int i = 0; i < 1000; i += 2)
+  {
+    while(marking.count(tokens[i]))
+      marking.erase(tokens[i]);
+  }
+
+  int size = 0;
+  for(int i = 0; i < 1000; ++i)
+  {
+    int expected = i % 2 ? (i % 3 == 0 ? 2 : 1) : 0;
+    BOOST_TEST(marking.count(tokens[i]) == expected);
+    size += expected;
+  }
+  BOOST_TEST(marking.size() == size);
+  BOOST_TEST(std::distance(marking.begin(), marking.end()) == size);
+}
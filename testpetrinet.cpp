@@ -27,6 +27,7 @@
 #include <iomanip>
 #include <iostream>
 #include <memory>
+#include <stdexcept>
 
 #include <boost/test/unit_test.hpp>
 
@@ -34,6 +35,7 @@
 #include "petrinet.h"
 #include "sharedtreepointer.h"
 #include "token.h"
+#include "tokentree.h"
 
 using namespace petrinet;
 
@@ -52,7 +54,9 @@ public:
   void action4() { *l_ = 4; }
   void action5(int i) { *i_ = i; }
   void action6(int* target, int v)   { *target = v; }
+  void actionThrow(int v) { throw std::runtime_error(std::to_string(v)); }
   void action7(int* target, double v1, float v2) { *target = v1 + v2; }
+  void action8(int* target, int v1, const std::string& v2, double v3, int v4) { *target = v1 + v2.size() + v3 + v4; }
   void actionArray(int i) { target_[i] += 1; }
 
   int* i_;
@@ -214,6 +218,30 @@ BOOST_AUTO_TEST_CASE(testDoubleToken)
   BOOST_TEST(p.tokens(3).size() == 2);
 }
 
+BOOST_AUTO_TEST_CASE(testCompileExtend)
+{
+  PetriNet p;
+  p.createPlace(1);
+  p.createPlace(2);
+  p.createTransition(1, {1}, {2});
+  p.compile();
+
+  SharedTreePointer<Token> token = SharedTreePointer<Token>(new MyToken());
+  p.addToken(1, token);
+  p.queueFire(1, token);
+  BOOST_TEST(p.tokens(2).size() == 1);
+
+  // Growing the net after compiling keeps the marking
+  for(int i = 3; i < 100; ++i)
+    p.createPlace(i);
+  p.createTransition(2, {2}, {3});
+
+  BOOST_TEST(p.tokens(2).size() == 1);
+  p.queueFire(2, token);
+  BOOST_TEST(p.tokens(2).size() == 0);
+  BOOST_TEST(p.tokens(3).size() == 1);
+}
+
 BOOST_AUTO_TEST_CASE(testFireParameter0)
 {
   PetriNet p;
@@ -296,6 +324,48 @@ BOOST_AUTO_TEST_CASE(testFireParameter3Queued)
   BOOST_TEST(target == 5);
 }
 
+BOOST_AUTO_TEST_CASE(testTypedTransition)
+{
+  PetriNet p;
+  p.createPlace(1);
+  p.createPlace(2);
+  p.createPlace(3);
+  auto first  = p.createTypedTransition(1, {1}, {2}, &MyToken::action1);
+  auto second = p.createTypedTransition(2, {2}, {3}, &MyToken::action8);
+
+  int i = 0;
+  SharedTreePointer<Token> token = SharedTreePointer<Token>(new MyToken(&i));
+  p.addToken(1, token);
+
+  std::vector<Fire> rejected;
+  p.setOverflow(Overflow::Reject, [&rejected](const Fire& f){ rejected.push_back(f); });
+
+  // A plain fire lacks the arguments of the action
+  std::vector<Fire> plain = {Fire(2, token)};
+  BOOST_TEST((p.queueFire(2, token).result() == QueueResult::Rejected));
+  p.queueFires(plain.begin(), plain.end());
+  BOOST_TEST(p.queueDepth() == 0);
+  BOOST_TEST(rejected.size() == 2);
+
+  // The action would cast a token of another type
+  SharedTreePointer<Token> other = SharedTreePointer<Token>(new Token());
+  int unused = 0;
+  BOOST_TEST((p.queueTypedFire(second, other, &unused, 1, std::string("abc"), 2.0, 4).result() == QueueResult::Rejected));
+  BOOST_TEST((p.queueFire(1, other).result() == QueueResult::Rejected));
+  BOOST_TEST(p.queueDepth() == 0);
+  BOOST_TEST(rejected.size() == 4);
+  BOOST_TEST(rejected.back().token().get() == other.get());
+
+  // Queued before its token arrives, the arguments travel with the fire
+  int target = 0;
+  BOOST_TEST((p.queueTypedFire(second, token, &target, 1, std::string("abc"), 2.0, 4).result() == QueueResult::Queued));
+  BOOST_TEST((p.queueTypedFire(first, token).result() == QueueResult::Fired));
+
+  BOOST_TEST(i == 1);
+  BOOST_TEST(target == 10);
+  BOOST_TEST(p.tokens(3).size() == 1);
+}
+
 
 BOOST_AUTO_TEST_CASE(testComplexPetriNet)
 {
@@ -450,6 +520,69 @@ BOOST_AUTO_TEST_CASE(testLevelUp)
   BOOST_TEST(target == 5);
 }
 
+
+class MyTreeToken : public TreeToken
+{
+public:
+  MyTreeToken(int* destroyed) : destroyed_(destroyed) {}
+  ~MyTreeToken() { ++*destroyed_; }
+
+  void action(int* target, int value) { *target += value; }
+
+private:
+  int* destroyed_;
+};
+
+BOOST_AUTO_TEST_CASE(testTokenTree)
+{
+  int destroyed = 0;
+  int target = 0;
+  {
+    TokenTreeBuilder builder;
+    MyTreeToken* root = builder.root<MyTreeToken>(&destroyed);
+    MyTreeToken* a = builder.child<MyTreeToken>(root, &destroyed);
+    MyTreeToken* b = builder.child<MyTreeToken>(root, &destroyed);
+    MyTreeToken* c = builder.child<MyTreeToken>(a, &destroyed);
+    MyTreeToken* d = builder.child<MyTreeToken>(b, &destroyed);
+    MyTreeToken* e = builder.child<MyTreeToken>(b, &destroyed);
+    SharedTreePointer<Token> token = builder.build();
+
+    // Level order in the arena as well
+    BOOST_TEST(a < b);
+    BOOST_TEST(b < c);
+    BOOST_TEST(d < e);
+    BOOST_TEST(token.get() == root);
+    BOOST_TEST(token.child(1).child(1).get() == e);
+    BOOST_TEST(token.child(0)->size() == 1);
+    BOOST_TEST(token.levelSize(2) == 2);
+    BOOST_TEST(token.levelSize(3) == 3);
+    BOOST_TEST(token.levelSize(4) == 0);
+    BOOST_TEST(token.child(1).levelSize(3) == 2);
+
+    SharedTreePointer<Token>::iterator it = token.begin(3);
+    BOOST_TEST((*it).get() == c);
+    BOOST_TEST((*++it).get() == d);
+
+    // Log messages hold on to the fire until they are written
+    PetriNet p;
+    p.setLogging(false);
+    p.createPlace(1, -1, 2);
+    p.createPlace(2);
+    p.createTransition(1, {1}, {2}, &MyTreeToken::action);
+
+    p.addToken(1, token.child(0));
+    p.addToken(1, token.child(1));
+    p.queueFire(1, token, &target, 2);
+    BOOST_TEST(p.tokens(2).size() == 1);
+
+    // The net keeps the whole tree alive
+    token = SharedTreePointer<Token>();
+    BOOST_TEST(destroyed == 0);
+  }
+  BOOST_TEST(destroyed == 6);
+  BOOST_TEST(target == 2);
+}
+
 BOOST_AUTO_TEST_CASE(testPerformance)
 {
 #ifdef _DEBUG
@@ -500,6 +633,74 @@ BOOST_AUTO_TEST_CASE(testPerformance)
 }
 
 
+BOOST_AUTO_TEST_CASE(testQueueFires)
+{
+  PetriNet p;
+  p.createPlace(1);
+  p.createPlace(2, 1);
+  p.createPlace(3);
+  p.createTransition(1, {1}, {2});
+  p.createTransition(2, {2}, {3}, &MyToken::action5);
+
+  int target = 0;
+  SharedTreePointer<Token> token1 = SharedTreePointer<Token>(new MyToken(&target));
+  SharedTreePointer<Token> token2 = SharedTreePointer<Token>(new MyToken(&target));
+  p.addToken(1, token1);
+  p.addToken(1, token2);
+
+  // Fires depending on later fires in the same range
+  std::vector<Fire> fires;
+  fires.push_back(Fire(2, token1, 5));
+  fires.push_back(Fire(2, token2, 6));
+  fires.push_back(Fire(1, token1));
+  fires.push_back(Fire(1, token2));
+  p.queueFires(fires.begin(), fires.end());
+
+  BOOST_TEST(target == 6);
+  BOOST_TEST(p.tokens(1).size() == 0);
+  BOOST_TEST(p.tokens(2).size() == 0);
+  BOOST_TEST(p.tokens(3).size() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(testPerformanceQueueFires)
+{
+#ifdef _DEBUG
+  const int amountOfTests = 30;
+#else
+  const int amountOfTests = 30000;
+#endif
+
+  PetriNet p;
+  p.createPlace(1);
+  p.createPlace(2, 3);
+  p.reserve(amountOfTests * 2);
+
+  int target = 0;
+  p.createTransition(1, {},  {1});
+  p.createTransition(2, {1}, {2}, &MyTokenLvl1::action);
+  p.createTransition(3, {2}, {});
+
+  std::vector<SharedTreePointer<Token>> tokens;
+  for(int i = 0; i < amountOfTests; ++i)
+    tokens.push_back(SharedTreePointer<Token>(new MyTokenLvl1()));
+
+  p.queueFires(2, tokens.begin(), tokens.end(), &target, 1);
+  p.queueFires(3, tokens.begin(), tokens.end());
+
+  std::clock_t c_start = std::clock();
+
+  p.queueFires(1, tokens.begin(), tokens.end());
+
+  std::clock_t c_end = std::clock();
+
+  std::cerr << std::fixed << std::setprecision(2) << "CPU time used: "
+              << 1000.0 * (c_end-c_start) / CLOCKS_PER_SEC << " ms, for "
+              << amountOfTests << " signals in one batch\n";
+
+  BOOST_TEST(target == amountOfTests);
+}
+
+
 BOOST_AUTO_TEST_CASE(testPerformanceMaxCapacity)
 {
   
@@ -560,6 +761,837 @@ BOOST_AUTO_TEST_CASE(testPerformanceMaxCapacity)
 }
 
 
+BOOST_AUTO_TEST_CASE(testCascadeNeighbourhood)
+{
+  PetriNet p;
+  p.createPlace(1);
+  p.createPlace(2, 1);
+  p.createPlace(3);
+  p.createPlace(4);
+  p.createTransition(1, {1}, {2});
+  p.createTransition(2, {2}, {3});
+  p.createTransition(3, {3}, {4});
+
+  SharedTreePointer<Token> tokenA = SharedTreePointer<Token>(new MyToken());
+  SharedTreePointer<Token> tokenB = SharedTreePointer<Token>(new MyToken());
+  p.addToken(1, tokenA);
+  p.addToken(1, tokenB);
+
+  p.queueFire(1, tokenA);
+  p.queueFire(1, tokenB);
+  p.queueFire(3, tokenA);
+  p.queueFire(3, tokenB);
+  BOOST_TEST(p.tokens(1).size() == 1);
+  BOOST_TEST(p.tokens(2).size() == 1);
+
+  // Token A cascades downstream, the freed capacity lets token B in
+  p.queueFire(2, tokenA);
+  BOOST_TEST(p.tokens(1).size() == 0);
+  BOOST_TEST(contains(p.tokens(2), tokenB));
+  BOOST_TEST(contains(p.tokens(4), tokenA));
+
+  p.queueFire(2, tokenB);
+  BOOST_TEST(p.tokens(2).size() == 0);
+  BOOST_TEST(p.tokens(4).size() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(testIncrementalFanIn)
+{
+  PetriNet p;
+  p.setPropagation(Propagation::Incremental);
+  p.createPlace(1);
+  p.createPlace(2);
+  p.createPlace(3);
+  p.createPlace(4);
+  p.createPlace(5);
+  p.createTransition(1, {},        {1});
+  p.createTransition(2, {},        {2});
+  p.createTransition(3, {},        {3});
+  p.createTransition(4, {1, 2, 3}, {4});
+  p.createTransition(5, {4, 4},    {5});
+
+  SharedTreePointer<Token> token = SharedTreePointer<Token>(new MyToken());
+  p.queueFire(4, token);
+  p.queueFire(5, token);
+  p.queueFire(1, token);
+  p.queueFire(2, token);
+  BOOST_TEST(p.tokens(4).size() == 0);
+
+  // The last missing input makes the queued fire ready
+  p.queueFire(3, token);
+  BOOST_TEST(p.tokens(3).size() == 0);
+  BOOST_TEST(p.tokens(4).size() == 1);
+
+  // Tokens added directly also complete queued fires
+  p.addToken(4, token);
+  BOOST_TEST(p.tokens(4).size() == 0);
+  BOOST_TEST(p.tokens(5).size() == 1);
+}
+
+void runCapacityCascade(Propagation propagation)
+{
+  PetriNet p;
+  p.setPropagation(propagation);
+  p.createPlace(1);
+  p.createPlace(2, 2, 2);
+  p.createPlace(3);
+  p.createTransition(1, {1}, {2}, &MyTokenLvl1::action);
+  p.createTransition(2, {2}, {3});
+
+  SharedTreePointer<Token> token1 = SharedTreePointer<Token>(new MyTokenLvl1());
+  SharedTreePointer<Token> token2 = SharedTreePointer<Token>(new MyTokenLvl1());
+
+  int target = 0;
+  p.addToken(1, token1);
+  p.addToken(1, token2);
+  p.queueFire(1, token1, &target, 1);
+  p.queueFire(1, token2, &target, 2);
+  BOOST_TEST(target == 1);
+  BOOST_TEST(p.tokens(2).size() == 2);
+
+  // Moving the children of token1 on frees the capacity token2 waits for
+  p.queueFire(2, token1);
+  BOOST_TEST(target == 3);
+  BOOST_TEST(contains(p.tokens(2), token2.child(0)));
+  BOOST_TEST(contains(p.tokens(2), token2.child(1)));
+  BOOST_TEST(p.tokens(3).size() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(testCapacityCascadeSearch)
+{
+  runCapacityCascade(Propagation::Search);
+}
+
+BOOST_AUTO_TEST_CASE(testCapacityCascadeIncremental)
+{
+  runCapacityCascade(Propagation::Incremental);
+}
+
+BOOST_AUTO_TEST_CASE(testCapacityWakeAfterLostInput)
+{
+  PetriNet p;
+  p.setPropagation(Propagation::Incremental);
+  p.createPlace(1);
+  p.createPlace(9, 1);
+  p.createTransition(1, {1}, {9});
+  p.createTransition(2, {1}, {});
+  p.createTransition(3, {9}, {});
+
+  SharedTreePointer<Token> a(new MyToken());
+  SharedTreePointer<Token> c(new MyToken());
+  SharedTreePointer<Token> x(new MyToken());
+  p.addToken(9, x);
+  p.addToken(1, a);
+  p.addToken(1, c);
+
+  // Both wait for the capacity of place 9, then a loses its input
+  p.queueFire(1, a);
+  p.queueFire(1, c);
+  p.queueFire(2, a);
+
+  // The fire woken for the capacity cannot use it, it goes on to c
+  p.queueFire(3, x);
+  BOOST_TEST(p.tokens(9).count(c) == 1);
+  BOOST_TEST(p.queueDepth() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(testPerformanceWideNet)
+{
+#ifdef _DEBUG
+  const int amountOfTests = 30;
+  const int amountOfTransitions = 100;
+#else
+  const int amountOfTests = 3000;
+  const int amountOfTransitions = 1000;
+#endif
+
+  PetriNet p;
+  p.createPlace(1);
+  p.createPlace(2);
+  p.createPlace(3);
+
+  // Unrelated transitions, cascades should not have to visit them
+  for(int i = 0; i < amountOfTransitions; ++i)
+  {
+    p.createPlace(10 + i);
+    p.createTransition(10 + i, {10 + i}, {});
+  }
+
+  int target = 0;
+  p.createTransition(1, {},  {1});
+  p.createTransition(2, {1}, {2});
+  p.createTransition(3, {2}, {3}, &MyTokenLvl1::action);
+
+  std::vector<SharedTreePointer<Token>> tokens;
+  for(int i = 0; i < amountOfTests; ++i)
+    tokens.push_back(SharedTreePointer<Token>(new MyTokenLvl1()));
+
+  std::for_each(tokens.begin(), tokens.end(), std::bind(&PetriNet::queueFire, &p, 3, std::placeholders::_1, &target, 1, boost::any()));
+  std::for_each(tokens.begin(), tokens.end(), std::bind(&PetriNet::queueFire, &p, 2, std::placeholders::_1, boost::any(), boost::any(), boost::any()));
+
+  std::clock_t c_start = std::clock();
+
+  std::for_each(tokens.begin(), tokens.end(), std::bind(&PetriNet::queueFire, &p, 1, std::placeholders::_1, boost::any(), boost::any(), boost::any()));
+
+  std::clock_t c_end = std::clock();
+
+  std::cerr << std::fixed << std::setprecision(2) << "CPU time used: "
+              << 1000.0 * (c_end-c_start) / CLOCKS_PER_SEC << " ms, for "
+              << amountOfTests << " signals through " << amountOfTransitions << " transitions\n";
+
+  BOOST_TEST(target == amountOfTests);
+  BOOST_TEST(p.tokens(3).size() == amountOfTests);
+}
+
+
+double runPerformancePropagation(Propagation propagation, const char* name)
+{
+#ifdef _DEBUG
+  const int amountOfTests = 10;
+  const int fanOut = 10;
+#else
+  const int amountOfTests = 100;
+  const int fanOut = 1000;
+#endif
+
+  // Transition 1 hands every token to fanOut branches that each move it to the sink
+  PetriNet p;
+  p.setPropagation(propagation);
+  p.createPlace(0);
+  p.createPlace(fanOut + 1);
+  std::list<int> branches;
+  for(int i = 1; i <= fanOut; ++i)
+  {
+    p.createPlace(i);
+    p.createTransition(i + 1, {i}, {fanOut + 1});
+    branches.push_back(i);
+  }
+  p.createTransition(1, {0}, branches);
+
+  std::vector<SharedTreePointer<Token>> tokens;
+  for(int i = 0; i < amountOfTests; ++i)
+  {
+    tokens.push_back(SharedTreePointer<Token>(new MyToken()));
+    p.addToken(0, tokens.back());
+  }
+
+  for(int i = 1; i <= fanOut; ++i)
+    std::for_each(tokens.begin(), tokens.end(), std::bind(&PetriNet::queueFire, &p, i + 1, std::placeholders::_1, boost::any(), boost::any(), boost::any()));
+
+  std::clock_t c_start = std::clock();
+
+  std::for_each(tokens.begin(), tokens.end(), std::bind(&PetriNet::queueFire, &p, 1, std::placeholders::_1, boost::any(), boost::any(), boost::any()));
+
+  std::clock_t c_end = std::clock();
+
+  std::cerr << std::fixed << std::setprecision(2) << "CPU time used: "
+              << 1000.0 * (c_end-c_start) / CLOCKS_PER_SEC << " ms, for "
+              << amountOfTests << " signals fanning out to " << fanOut << " transitions (" << name << ")\n";
+
+  BOOST_TEST(p.tokens(0).size() == 0);
+  BOOST_TEST(p.tokens(fanOut + 1).size() == amountOfTests * fanOut);
+  return 1000.0 * (c_end-c_start) / CLOCKS_PER_SEC;
+}
+
+BOOST_AUTO_TEST_CASE(testPerformancePropagation)
+{
+  double search   = runPerformancePropagation(Propagation::Search,      "search");
+  double worklist = runPerformancePropagation(Propagation::Worklist,    "worklist");
+  runPerformancePropagation(Propagation::Incremental, "incremental");
+
+#ifndef _DEBUG
+  // A put only reaches the consumers with a fire for its token, the worklist
+  // keeps up with the search however wide the fan-out
+  BOOST_TEST(worklist < 2 * search);
+#endif
+}
+
+void runParallelPipelines(Propagation propagation, int threads, const char* name)
+{
+#ifdef _DEBUG
+  const int amountOfTests = 100;
+#else
+  const int amountOfTests = 5000;
+#endif
+  const int amountOfPipelines = 8;
+
+  // Independent pipelines, each a conflict component of its own
+  PetriNet p;
+  p.setPropagation(propagation);
+  p.setParallel(threads);
+
+  std::vector<int> targets(amountOfPipelines * amountOfTests, 0);
+  std::vector<SharedTreePointer<Token>> tokens;
+  std::vector<Fire> fires;
+  for(int i = 0; i < amountOfPipelines; ++i)
+  {
+    p.createPlace(3*i + 1);
+    p.createPlace(3*i + 2, 1);
+    p.createPlace(3*i + 3);
+    p.createTransition(2*i + 1, {3*i + 1}, {3*i + 2});
+    p.createTransition(2*i + 2, {3*i + 2}, {3*i + 3}, &MyToken::action1);
+
+    for(int j = 0; j < amountOfTests; ++j)
+    {
+      tokens.push_back(SharedTreePointer<Token>(new MyToken(&targets[i*amountOfTests + j])));
+      p.addToken(3*i + 1, tokens.back());
+      fires.push_back(Fire(2*i + 2, tokens.back()));
+    }
+  }
+
+  for(int i = 0; i < amountOfPipelines; ++i)
+  {
+    for(int j = 0; j < amountOfTests; ++j)
+      fires.push_back(Fire(2*i + 1, tokens[i*amountOfTests + j]));
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  p.queueFires(fires.begin(), fires.end());
+
+  auto end = std::chrono::steady_clock::now();
+
+  std::cerr << std::fixed << std::setprecision(2) << "Wall time used: "
+              << std::chrono::duration<double, std::milli>(end - start).count() << " ms, for "
+              << amountOfTests << " signals through " << amountOfPipelines << " pipelines on "
+              << threads << " threads (" << name << ")\n";
+
+  BOOST_TEST(std::count(targets.begin(), targets.end(), 1) == targets.size());
+  for(int i = 0; i < amountOfPipelines; ++i)
+  {
+    BOOST_TEST(p.tokens(3*i + 1).size() == 0);
+    BOOST_TEST(p.tokens(3*i + 2).size() == 0);
+    BOOST_TEST(p.tokens(3*i + 3).size() == amountOfTests);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testParallelQueueFires)
+{
+  runParallelPipelines(Propagation::Worklist,    0, "worklist");
+  runParallelPipelines(Propagation::Worklist,    4, "worklist");
+  runParallelPipelines(Propagation::Search,      4, "search");
+  runParallelPipelines(Propagation::Incremental, 4, "incremental");
+}
+
+BOOST_AUTO_TEST_CASE(testActionThreads)
+{
+#ifdef _DEBUG
+  const int amountOfTests = 100;
+#else
+  const int amountOfTests = 10000;
+#endif
+
+  PetriNet p;
+  p.setActionThreads(4);
+  p.createPlace(1);
+  p.createPlace(2);
+  p.createPlace(3);
+  p.createTransition(1, {},  {1}, &MyToken::action6);
+  p.createTransition(2, {1}, {2}, &MyToken::action6);
+  p.createTransition(3, {2}, {3}, &MyToken::action6);
+
+  // Actions on the same token keep the order of their fires
+  std::vector<int> targets(amountOfTests, 0);
+  for(int i = 0; i < amountOfTests; ++i)
+  {
+    SharedTreePointer<Token> token(new MyToken());
+    p.queueFire(3, token, &targets[i], 3);
+    p.queueFire(2, token, &targets[i], 2);
+    p.queueFire(1, token, &targets[i], 1);
+  }
+
+  p.waitForActions();
+
+  BOOST_TEST(std::count(targets.begin(), targets.end(), 3) == amountOfTests);
+  BOOST_TEST(p.tokens(3).size() == amountOfTests);
+}
+
+BOOST_AUTO_TEST_CASE(testActionThreadsThrow)
+{
+  PetriNet p;
+  p.setActionThreads(2);
+  p.createPlace(1);
+  p.createPlace(2);
+  p.createTransition(1, {},  {1}, &MyToken::actionThrow);
+  p.createTransition(2, {1}, {2}, &MyToken::action6);
+
+  // The action after the throwing one on its strand still runs
+  int target = 0;
+  SharedTreePointer<Token> token(new MyToken());
+  p.queueFire(1, token, 1);
+  p.queueFire(2, token, &target, 2);
+
+  BOOST_CHECK_THROW(p.waitForActions(), std::runtime_error);
+  BOOST_TEST(target == 2);
+  BOOST_TEST(p.tokens(2).size() == 1);
+  BOOST_CHECK_NO_THROW(p.waitForActions());
+}
+
+BOOST_AUTO_TEST_CASE(testSubmitFromThreads)
+{
+#ifdef _DEBUG
+  const int amountOfTests = 100;
+#else
+  const int amountOfTests = 10000;
+#endif
+  const int amountOfProducers = 4;
+
+  PetriNet p;
+  p.createPlace(1);
+  p.createPlace(2, 1);
+  p.createPlace(3);
+  p.createTransition(1, {1}, {2});
+  p.createTransition(2, {2}, {3});
+
+  // Each producer submits its tokens and the fires moving them to place 3
+  boost::thread_group producers;
+  for(int i = 0; i < amountOfProducers; ++i)
+  {
+    producers.create_thread([&p, amountOfTests]
+    {
+      for(int j = 0; j < amountOfTests; ++j)
+      {
+        SharedTreePointer<Token> token(new MyToken());
+        p.submitToken(1, token);
+        p.submitFire(2, token);
+        p.submitFire(1, token);
+      }
+    });
+  }
+  producers.join_all();
+
+  p.waitForSubmitted();
+
+  BOOST_TEST(p.tokens(1).size() == 0);
+  BOOST_TEST(p.tokens(2).size() == 0);
+  BOOST_TEST(p.tokens(3).size() == amountOfTests * amountOfProducers);
+}
+
+void runShardedPipelines(Propagation propagation, int shards, const char* name)
+{
+#ifdef _DEBUG
+  const int amountOfTests = 100;
+#else
+  const int amountOfTests = 5000;
+#endif
+  const int amountOfPipelines = 8;
+
+  // Every pipeline is cut at its unbounded middle place
+  PetriNet p;
+  p.setPropagation(propagation);
+  for(int i = 0; i < amountOfPipelines; ++i)
+  {
+    p.createPlace(3*i + 1, 1);
+    p.createPlace(3*i + 2);
+    p.createPlace(3*i + 3);
+    p.createTransition(2*i + 1, {3*i + 1}, {3*i + 2});
+    p.createTransition(2*i + 2, {3*i + 2}, {3*i + 3});
+  }
+  p.setShards(shards);
+
+  auto start = std::chrono::steady_clock::now();
+
+  boost::thread_group producers;
+  for(int i = 0; i < amountOfPipelines; ++i)
+  {
+    producers.create_thread([&p, i, amountOfTests]
+    {
+      for(int j = 0; j < amountOfTests; ++j)
+      {
+        SharedTreePointer<Token> token(new MyToken());
+        p.submitFire(2*i + 2, token);
+        p.submitToken(3*i + 1, token);
+        p.submitFire(2*i + 1, token);
+      }
+    });
+  }
+  producers.join_all();
+  p.waitForSubmitted();
+
+  auto end = std::chrono::steady_clock::now();
+
+  std::cerr << std::fixed << std::setprecision(2) << "Wall time used: "
+              << std::chrono::duration<double, std::milli>(end - start).count() << " ms, for "
+              << amountOfTests << " signals through " << amountOfPipelines << " pipelines on "
+              << shards << " shards (" << name << ")\n";
+
+  for(int i = 0; i < amountOfPipelines; ++i)
+  {
+    BOOST_TEST(p.tokens(3*i + 1).size() == 0);
+    BOOST_TEST(p.tokens(3*i + 2).size() == 0);
+    BOOST_TEST(p.tokens(3*i + 3).size() == amountOfTests);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testShards)
+{
+  runShardedPipelines(Propagation::Worklist,    1, "worklist");
+  runShardedPipelines(Propagation::Worklist,    4, "worklist");
+  runShardedPipelines(Propagation::Search,      4, "search");
+  runShardedPipelines(Propagation::Incremental, 4, "incremental");
+}
+
+void runScheduling(Scheduling scheduling, const std::vector<int>& expectedOrder)
+{
+  PetriNet p;
+  p.setScheduling(scheduling);
+  p.createPlace(1, 1);
+  p.createTransition(1, {},  {1});
+  p.createTransition(2, {1}, {});
+
+  SharedTreePointer<Token> current(new MyToken());
+  p.addToken(1, current);
+
+  // All blocked by the capacity of place 1
+  auto now = std::chrono::steady_clock::now();
+  std::vector<Fire> fires;
+  for(int i = 0; i < 3; ++i)
+    fires.push_back(Fire(1, SharedTreePointer<Token>(new MyToken())));
+  fires[0].setPriority(1);
+  fires[1].setPriority(3);
+  fires[2].setPriority(2);
+  fires[0].setDeadline(now + std::chrono::seconds(3));
+  fires[1].setDeadline(now + std::chrono::seconds(2));
+  fires[2].setDeadline(now + std::chrono::seconds(1));
+  p.queueFires(fires.begin(), fires.end());
+
+  // Each token taken from place 1 lets the next fire in
+  for(auto it = expectedOrder.begin(); it != expectedOrder.end(); ++it)
+  {
+    p.queueFire(2, current);
+    current = fires[*it].token();
+    BOOST_TEST(p.tokens(1).count(current) == 1);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testScheduling)
+{
+  runScheduling(Scheduling::Fifo,             {0, 1, 2});
+  runScheduling(Scheduling::Priority,         {1, 2, 0});
+  runScheduling(Scheduling::EarliestDeadline, {2, 1, 0});
+}
+
+BOOST_AUTO_TEST_CASE(testTimedTransition)
+{
+  PetriNet p;
+  p.createPlace(1);
+  p.createPlace(2);
+  p.createTransition(1, {1}, {2});
+  p.setDelay(1, std::chrono::milliseconds(50));
+
+  SharedTreePointer<Token> token(new MyToken());
+  p.addToken(1, token);
+
+  // Only submitted fires wait for the delay
+  BOOST_TEST((p.queueFire(1, token).result() == QueueResult::Rejected));
+
+  auto start = std::chrono::steady_clock::now();
+  p.submitFire(1, token);
+  p.waitForSubmitted();
+
+  BOOST_TEST((std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(50)));
+  BOOST_TEST(p.tokens(1).size() == 0);
+  BOOST_TEST(p.tokens(2).size() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(testPerformanceTimeouts)
+{
+#ifdef _DEBUG
+  const int amountOfTests = 1000;
+#else
+  const int amountOfTests = 100000;
+#endif
+
+  PetriNet p;
+  p.createPlace(1);
+  p.createPlace(2);
+  p.createTransition(1, {1}, {2});
+
+  std::vector<SharedTreePointer<Token>> tokens;
+  for(int i = 0; i < amountOfTests; ++i)
+  {
+    tokens.push_back(SharedTreePointer<Token>(new MyToken()));
+    p.addToken(1, tokens.back());
+  }
+
+  std::clock_t c_start = std::clock();
+
+  // Spread over more than a turn of the lowest level
+  for(int i = 0; i < amountOfTests; ++i)
+    p.submitFireAfter(std::chrono::milliseconds(i % 300), 1, tokens[i]);
+
+  std::clock_t c_end = std::clock();
+
+  p.waitForSubmitted();
+
+  std::cerr << std::fixed << std::setprecision(2) << "CPU time used: "
+              << 1000.0 * (c_end-c_start) / CLOCKS_PER_SEC << " ms, for "
+              << amountOfTests << " timeouts\n";
+
+  BOOST_TEST(p.tokens(1).size() == 0);
+  BOOST_TEST(p.tokens(2).size() == amountOfTests);
+}
+
+void runPerformanceSparseWaiters(Propagation propagation, const char* name)
+{
+#ifdef _DEBUG
+  const int amountOfTests = 10;
+  const int amountOfConsumers = 10;
+#else
+  const int amountOfTests = 3000;
+  const int amountOfConsumers = 1000;
+#endif
+
+  // Every consumer of place 1 waits for other tokens, a token put into it
+  // has a single taker
+  PetriNet p;
+  p.setPropagation(propagation);
+  p.createPlace(0);
+  p.createPlace(1);
+  p.createPlace(2);
+  p.createTransition(1, {0}, {1});
+  for(int i = 0; i < amountOfConsumers; ++i)
+    p.createTransition(i + 2, {1}, {2});
+
+  std::vector<SharedTreePointer<Token>> tokens;
+  for(int i = 0; i < amountOfTests; ++i)
+  {
+    tokens.push_back(SharedTreePointer<Token>(new MyToken()));
+    p.addToken(0, tokens.back());
+    p.queueFire(i % amountOfConsumers + 2, tokens.back());
+  }
+
+  std::clock_t c_start = std::clock();
+
+  std::for_each(tokens.begin(), tokens.end(), std::bind(&PetriNet::queueFire, &p, 1, std::placeholders::_1, boost::any(), boost::any(), boost::any()));
+
+  std::clock_t c_end = std::clock();
+
+  std::cerr << std::fixed << std::setprecision(2) << "CPU time used: "
+              << 1000.0 * (c_end-c_start) / CLOCKS_PER_SEC << " ms, for "
+              << amountOfTests << " signals with " << amountOfConsumers << " waiting consumers (" << name << ")\n";
+
+  BOOST_TEST(p.tokens(1).size() == 0);
+  BOOST_TEST(p.tokens(2).size() == amountOfTests);
+}
+
+BOOST_AUTO_TEST_CASE(testPerformanceSparseWaiters)
+{
+  runPerformanceSparseWaiters(Propagation::Search,      "search");
+  runPerformanceSparseWaiters(Propagation::Worklist,    "worklist");
+  runPerformanceSparseWaiters(Propagation::Incremental, "incremental");
+}
+
+void runQueueLimit(Propagation propagation)
+{
+  PetriNet p;
+  p.setPropagation(propagation);
+  p.createPlace(1);
+  p.createPlace(2);
+  p.createTransition(1, {1}, {2});
+  p.createTransition(2, {1}, {2});
+  p.setQueueLimit(1, 2);
+  p.setQueueLimit(3);
+
+  std::vector<SharedTreePointer<Token>> tokens;
+  for(int i = 0; i < 4; ++i)
+    tokens.push_back(SharedTreePointer<Token>(new MyToken()));
+
+  // Rejected by the limit of the transition, then by the limit of the net
+  BOOST_TEST((p.queueFire(1, tokens[0]).result() == QueueResult::Queued));
+  BOOST_TEST((p.queueFire(1, tokens[1]).result() == QueueResult::Queued));
+  BOOST_TEST((p.queueFire(1, tokens[2]).result() == QueueResult::Rejected));
+  BOOST_TEST((p.queueFire(2, tokens[2]).result() == QueueResult::Queued));
+  BOOST_TEST((p.queueFire(2, tokens[3]).result() == QueueResult::Rejected));
+  BOOST_TEST(p.queueDepth(1) == 2);
+  BOOST_TEST(p.queueDepth(2) == 1);
+  BOOST_TEST(p.queueDepth() == 3);
+
+  // The oldest fire of transition 1 makes room
+  std::vector<Fire> dropped;
+  p.setOverflow(Overflow::DropOldest, [&dropped](const Fire& f){ dropped.push_back(f); });
+  BOOST_TEST((p.queueFire(1, tokens[3]).result() == QueueResult::Queued));
+  BOOST_TEST(dropped.size() == 1);
+  BOOST_TEST((dropped.front().token() == tokens[0]));
+  BOOST_TEST(p.queueDepth() == 3);
+
+  // A full queue does not stop fires that can fire
+  SharedTreePointer<Token> token(new MyToken());
+  p.addToken(1, token);
+  BOOST_TEST((p.queueFire(1, token).result() == QueueResult::Fired));
+  BOOST_TEST(p.tokens(2).count(token) == 1);
+  BOOST_TEST(p.queueDepth() == 3);
+}
+
+BOOST_AUTO_TEST_CASE(testQueueLimit)
+{
+  runQueueLimit(Propagation::Worklist);
+  runQueueLimit(Propagation::Incremental);
+}
+
+void runCancel(Propagation propagation)
+{
+  PetriNet p;
+  p.setPropagation(propagation);
+  p.createPlace(1);
+  p.createPlace(2);
+  p.createPlace(3);
+  p.createTransition(1, {1}, {2});
+  p.createTransition(2, {1}, {2});
+  p.createTransition(3, {3}, {1});
+  // A conflict component of its own
+  p.createPlace(4);
+  p.createPlace(5);
+  p.createTransition(4, {4}, {5});
+
+  SharedTreePointer<Token> session(new MyToken());
+  SharedTreePointer<Token> other(new MyToken());
+
+  FireHandle first = p.queueFire(1, session);
+  p.queueFire(2, session);
+  FireHandle second = p.queueFire(1, other);
+  BOOST_TEST((first.result() == QueueResult::Queued));
+  BOOST_TEST(p.queueDepth() == 3);
+
+  // A handle cancels once, also when its slot was reused
+  BOOST_TEST(p.cancel(first));
+  BOOST_TEST(!p.cancel(first));
+  FireHandle reused = p.queueFire(1, session);
+  BOOST_TEST(!p.cancel(first));
+  BOOST_TEST(p.queueDepth(1) == 2);
+
+  // The fires of a session are withdrawn together, in all components
+  p.queueFire(4, session);
+  BOOST_TEST(p.cancelFires(session) == 3);
+  BOOST_TEST(!p.cancel(reused));
+  BOOST_TEST(p.queueDepth() == 1);
+
+  // Cancelled fires do not fire once their token arrives
+  p.addToken(3, session);
+  p.addToken(3, other);
+  FireHandle fired = p.queueFire(3, session);
+  BOOST_TEST((fired.result() == QueueResult::Fired));
+  BOOST_TEST(!p.cancel(fired));
+  BOOST_TEST(p.tokens(1).count(session) == 1);
+
+  // Too late once the fire happened
+  p.queueFire(3, other);
+  BOOST_TEST(p.tokens(2).count(other) == 1);
+  BOOST_TEST(!p.cancel(second));
+  BOOST_TEST(p.queueDepth() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(testCancel)
+{
+  runCancel(Propagation::Search);
+  runCancel(Propagation::Worklist);
+  runCancel(Propagation::Incremental);
+}
+
+void runCounterPlace(Propagation propagation)
+{
+  // Two slots guard the requests in progress
+  PetriNet p;
+  p.setPropagation(propagation);
+  p.createPlace(1);
+  p.createCounterPlace(2);
+  p.createPlace(3);
+  p.createPlace(4);
+  p.createTransition(1, {1, 2}, {3});
+  p.createTransition(2, {3}, {4, 2});
+  p.addTokens(2, 2);
+
+  std::vector<SharedTreePointer<Token>> tokens;
+  for(int i = 0; i < 3; ++i)
+  {
+    tokens.push_back(SharedTreePointer<Token>(new MyToken()));
+    p.addToken(1, tokens.back());
+    p.queueFire(1, tokens.back());
+  }
+
+  BOOST_TEST(p.tokenCount(2) == 0);
+  BOOST_TEST(p.tokens(3).size() == 2);
+  BOOST_TEST(p.queueDepth() == 1);
+
+  // A released slot lets the waiting request in
+  p.queueFire(2, tokens[0]);
+  BOOST_TEST(p.tokenCount(2) == 0);
+  BOOST_TEST(p.tokens(3).count(tokens[2]) == 1);
+  BOOST_TEST(p.tokens(4).count(tokens[0]) == 1);
+
+  p.queueFire(2, tokens[1]);
+  p.queueFire(2, tokens[2]);
+  BOOST_TEST(p.tokenCount(2) == 2);
+  BOOST_TEST(p.tokens(2).size() == 0);
+  BOOST_TEST(p.tokenCount(4) == 3);
+
+  // Tokens added from outside release waiting fires in every propagation
+  std::vector<SharedTreePointer<Token>> late;
+  for(int i = 0; i < 3; ++i)
+    late.push_back(SharedTreePointer<Token>(new MyToken()));
+  p.queueFire(1, late[0]);
+  p.addToken(1, late[0]);
+  BOOST_TEST(p.tokens(3).count(late[0]) == 1);
+
+  p.addToken(1, late[1]);
+  p.addToken(1, late[2]);
+  p.queueFire(1, late[1]);
+  p.queueFire(1, late[2]);
+  BOOST_TEST(p.queueDepth() == 1);
+  p.addTokens(2, 1);
+  BOOST_TEST(p.tokens(3).count(late[2]) == 1);
+  BOOST_TEST(p.queueDepth() == 0);
+
+  // A released slot goes to a fire that can take it, also when the first
+  // one queued still lacks its token
+  SharedTreePointer<Token> absent(new MyToken());
+  SharedTreePointer<Token> present(new MyToken());
+  p.queueFire(1, absent);
+  p.queueFire(1, present);
+  p.addToken(1, present);
+  p.addTokens(2, 1);
+  BOOST_TEST(p.tokens(3).count(present) == 1);
+  BOOST_TEST(p.queueDepth() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(testCounterPlace)
+{
+  runCounterPlace(Propagation::Search);
+  runCounterPlace(Propagation::Worklist);
+  runCounterPlace(Propagation::Incremental);
+}
+
+void runTokenlessFire(Propagation propagation)
+{
+  // Only anonymous tokens move, the fires carry no token
+  PetriNet p;
+  p.setPropagation(propagation);
+  p.createCounterPlace(1);
+  p.createCounterPlace(2);
+  p.createTransition(1, {1}, {2});
+
+  BOOST_TEST((p.queueFire(1, SharedTreePointer<Token>()).result() == QueueResult::Queued));
+  BOOST_TEST((p.queueFire(1, SharedTreePointer<Token>()).result() == QueueResult::Queued));
+  BOOST_TEST(p.queueDepth() == 2);
+
+  p.addTokens(1, 1);
+  BOOST_TEST(p.tokenCount(2) == 1);
+  BOOST_TEST(p.queueDepth() == 1);
+
+  p.addTokens(1, 2);
+  BOOST_TEST(p.tokenCount(1) == 1);
+  BOOST_TEST(p.tokenCount(2) == 2);
+  BOOST_TEST(p.queueDepth() == 0);
+  BOOST_TEST((p.queueFire(1, SharedTreePointer<Token>()).result() == QueueResult::Fired));
+}
+
+BOOST_AUTO_TEST_CASE(testTokenlessFire)
+{
+  runTokenlessFire(Propagation::Search);
+  runTokenlessFire(Propagation::Worklist);
+  runTokenlessFire(Propagation::Incremental);
+}
+
 BOOST_AUTO_TEST_CASE(testLoop)
 {
   PetriNet p;
@@ -646,6 +1678,108 @@ BOOST_AUTO_TEST_CASE(testDoubleArcLevelUpFewTokens)
   BOOST_TEST(p.tokens(2).size() == 1);
 }
 
+void runWeightedArcs(Propagation propagation)
+{
+  PetriNet p;
+  p.setPropagation(propagation);
+  p.createPlace(1);
+  p.createPlace(2, -1, 2);
+  p.createPlace(3);
+  p.createTransition(1, {}, {Arc{1, 1000}});
+  p.createTransition(2, {Arc{1, 1500}}, {Arc{2, 3}, Arc{3, 1}});
+  // Repeated places and weights add up
+  p.createTransition(3, {Arc{2, 1}, Arc{2, 2}}, {3, 3});
+
+  SharedTreePointer<Token> token = SharedTreePointer<Token>(new MyTokenLvl1());
+  p.queueFire(1, token);
+  BOOST_TEST((p.queueFire(2, token).result() == QueueResult::Queued));
+  p.queueFire(3, token);
+  BOOST_TEST(p.tokens(1).count(token) == 1000);
+
+  p.queueFire(1, token);
+  BOOST_TEST(p.tokens(1).count(token) == 500);
+  BOOST_TEST(p.tokens(2).size() == 0);
+  BOOST_TEST(p.tokens(3).count(token) == 3);
+}
+
+BOOST_AUTO_TEST_CASE(testWeightedArcs)
+{
+  runWeightedArcs(Propagation::Search);
+  runWeightedArcs(Propagation::Worklist);
+  runWeightedArcs(Propagation::Incremental);
+}
+
+class MyKeyedToken : public Token
+{
+public:
+  MyKeyedToken(int id) : id_(id) {}
+  int id_;
+};
+
+void runJoin(Propagation propagation)
+{
+  PetriNet p;
+  p.setPropagation(propagation);
+  p.setLogging(false);
+  p.createPlace(1);
+  p.createPlace(2);
+  p.createPlace(3, 1);
+  p.createPlace(4);
+  p.createPlace(5);
+  auto id = [](const Token* t){ return (JoinKey) static_cast<const MyKeyedToken*>(t)->id_; };
+  p.setPlaceKey(1, id);
+  p.setPlaceKey(2, id);
+  p.createTransition(1, {5}, {2});
+  p.createTransition(2, {3}, {4});
+
+  std::vector<std::pair<int, int>> joined;
+  p.createJoinTransition(3, {1, 2}, {3}, [&joined](const JoinBindings& bindings)
+  {
+    joined.push_back(std::make_pair(bindings[0].get<MyKeyedToken>()->id_, bindings[1].get<MyKeyedToken>()->id_));
+  });
+
+  SharedTreePointer<Token> request1(new MyKeyedToken(1));
+  SharedTreePointer<Token> request2(new MyKeyedToken(2));
+  SharedTreePointer<Token> response1(new MyKeyedToken(1));
+  SharedTreePointer<Token> response2(new MyKeyedToken(2));
+  SharedTreePointer<Token> response3(new MyKeyedToken(3));
+  SharedTreePointer<Token> response4(new MyKeyedToken(4));
+
+  // Unmatched keys stay in their places
+  p.addToken(1, request1);
+  p.addToken(1, request2);
+  p.addToken(2, response3);
+  BOOST_TEST(joined.empty());
+
+  // A response put by a fire completes the binding, the request moves on
+  p.addToken(5, response1);
+  p.queueFire(1, response1);
+  BOOST_TEST(joined.size() == 1);
+  BOOST_TEST((joined[0] == std::make_pair(1, 1)));
+  BOOST_TEST(p.tokens(3).count(request1) == 1);
+  BOOST_TEST(p.tokenCount(1) == 1);
+  BOOST_TEST(p.tokenCount(2) == 1);
+
+  // Blocked by the capacity of the output, retried once there is room
+  p.addToken(2, response2);
+  BOOST_TEST(joined.size() == 1);
+  p.addToken(2, response4);
+  BOOST_TEST(joined.size() == 1);
+  p.queueFire(2, request1);
+  BOOST_TEST(joined.size() == 2);
+  BOOST_TEST(p.tokens(3).count(request2) == 1);
+  BOOST_TEST(p.tokenCount(1) == 0);
+  BOOST_TEST(p.tokens(2).count(response3) == 1);
+  BOOST_TEST(p.tokens(2).count(response4) == 1);
+}
+
+BOOST_AUTO_TEST_CASE(testJoin)
+{
+  runJoin(Propagation::Search);
+  runJoin(Propagation::Worklist);
+  runJoin(Propagation::Incremental);
+}
+
 
 class MyTokenMultiLevel : public Token
 {
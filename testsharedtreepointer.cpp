@@ -70,4 +70,108 @@ BOOST_AUTO_TEST_CASE(testBreadthFirstIteration)
   BOOST_TEST((*myToken.begin(2)).get() == a);
   BOOST_TEST((*myToken.end(2)).get() == d);
   BOOST_VERIFY(myToken.end() == iter);
+}
+
+BOOST_AUTO_TEST_CASE(testLevelIteration)
+{
+  SimpleToken *a, *b, *c, *d, *e;
+  SimpleToken* s = new SimpleToken();
+  s->children_.push_back(std::shared_ptr<SimpleToken>(a = new SimpleToken()));
+  s->children_.back()->children_.push_back(std::shared_ptr<SimpleToken>(c = new SimpleToken()));
+  s->children_.push_back(std::shared_ptr<SimpleToken>(new SimpleToken()));
+  s->children_.push_back(std::shared_ptr<SimpleToken>(b = new SimpleToken()));
+  s->children_.back()->children_.push_back(std::shared_ptr<SimpleToken>(d = new SimpleToken()));
+  s->children_.back()->children_.push_back(std::shared_ptr<SimpleToken>(e = new SimpleToken()));
+
+  SharedTreePointer<SimpleToken> myToken = SharedTreePointer<SimpleToken>(s);
+
+  // Skips the childless token in the middle
+  SharedTreePointer<SimpleToken>::level_iterator iter = myToken.levelBegin(3);
+  BOOST_TEST(iter->get() == c);
+  BOOST_TEST(iter->level() == 3);
+  ++iter;
+  BOOST_TEST(iter->get() == d);
+  ++iter;
+  BOOST_TEST(iter->get() == e);
+  ++iter;
+  BOOST_VERIFY(iter == myToken.levelEnd());
+
+  BOOST_TEST(std::distance(myToken.levelBegin(2), myToken.levelEnd()) == 3);
+  BOOST_TEST((*myToken.levelBegin(1)).get() == s);
+  BOOST_VERIFY(++myToken.levelBegin(1) == myToken.levelEnd());
+  BOOST_VERIFY(myToken.levelBegin(4) == myToken.levelEnd());
+
+  SharedTreePointer<SimpleToken> child = myToken.child(2);
+  iter = child.levelBegin(3);
+  BOOST_TEST(iter->get() == d);
+  BOOST_TEST(std::distance(iter, child.levelEnd()) == 2);
+}
+
+BOOST_AUTO_TEST_CASE(testDeepLevelIteration)
+{
+  // Deeper than the fixed stack of the iterator
+  const int depth = 2 * SharedTreePointer<SimpleToken>::level_iterator::inlineDepth;
+  SimpleToken* s = new SimpleToken();
+  SimpleToken* node = s;
+  for(int i = 0; i < depth; ++i)
+  {
+    node->children_.push_back(std::shared_ptr<SimpleToken>(new SimpleToken()));
+    node->children_.push_back(std::shared_ptr<SimpleToken>(new SimpleToken()));
+    node = node->children_.front().get();
+  }
+
+  SharedTreePointer<SimpleToken> myToken = SharedTreePointer<SimpleToken>(s);
+
+  SharedTreePointer<SimpleToken>::level_iterator iter = myToken.levelBegin(depth + 1);
+  BOOST_TEST(iter->get() == node);
+  BOOST_TEST(iter->level() == depth + 1);
+  BOOST_TEST(std::distance(iter, myToken.levelEnd()) == 2);
+  BOOST_TEST(std::distance(myToken.levelBegin(depth), myToken.levelEnd()) == 2);
+}
+
+class CountedToken : public RefCounted
+{
+public:
+  CountedToken(bool* destroyed) : destroyed_(destroyed) {}
+  ~CountedToken() { *destroyed_ = true; }
+
+  virtual int size() const { return children_.size(); }
+  virtual CountedToken* child(int i) const { return children_.at(i).get(); }
+
+  std::vector<std::unique_ptr<CountedToken>> children_;
+  bool* destroyed_;
+};
+
+BOOST_AUTO_TEST_CASE(testIntrusiveCount)
+{
+  for(int singleThreaded = 0; singleThreaded < 2; ++singleThreaded)
+  {
+    bool destroyed = false, childDestroyed = false;
+    CountedToken* root = new CountedToken(&destroyed);
+    root->children_.push_back(std::unique_ptr<CountedToken>(new CountedToken(&childDestroyed)));
+    root->setSingleThreaded(singleThreaded != 0);
+
+    SharedTreePointer<CountedToken> token(root);
+    BOOST_TEST(token.unique());
+
+    // Children count in the root
+    SharedTreePointer<CountedToken> child = token.child(0);
+    BOOST_TEST(token.use_count() == 2);
+    BOOST_TEST(root->references() == 2);
+
+    SharedTreePointer<CountedToken> moved(std::move(token));
+    BOOST_TEST(!token.get());
+    BOOST_TEST(moved.use_count() == 2);
+
+    token = std::move(child);
+    BOOST_TEST(!child.get());
+    BOOST_TEST(token.level() == 2);
+    BOOST_TEST(token.use_count() == 2);
+
+    moved = SharedTreePointer<CountedToken>();
+    BOOST_TEST(!destroyed);
+    token = moved;
+    BOOST_TEST(destroyed);
+    BOOST_TEST(childDestroyed);
+  }
 }
\ No newline at end of file
@@ -0,0 +1,111 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+
+#include <memory>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include "staticnet.h"
+#include "token.h"
+
+using namespace petrinet;
+
+class StaticToken : public Token
+{
+public:
+  StaticToken(int children = 0)
+  {
+    for(int i = 0; i < children; ++i)
+      children_.push_back(std::shared_ptr<Token>(new StaticToken()));
+  }
+
+  virtual int size() const { return children_.size(); }
+  virtual Token* child(int i) const { return children_.at(i).get(); }
+
+  static int fired;
+  std::vector<std::shared_ptr<Token>> children_;
+};
+
+int StaticToken::fired = 0;
+
+struct CountFire
+{
+  void operator()(Token*) const { ++StaticToken::fired; }
+};
+
+typedef StaticNet<
+  StaticPlaces<StaticPlace<1, 4>, StaticPlace<2, 2>, StaticPlace<3, 8, 2>, StaticCounterPlace<4>, StaticCounterPlace<5, 3>>,
+  StaticTransitions<
+    StaticTransition<1, StaticInputs<StaticArc<1>, StaticArc<4, 2>>, StaticOutputs<StaticArc<2>, StaticArc<3>>, CountFire>,
+    StaticTransition<2, StaticInputs<StaticArc<2>>, StaticOutputs<StaticArc<5, 3>>>>
+> TestStaticNet;
+
+BOOST_AUTO_TEST_CASE(testStaticNetFire)
+{
+  StaticToken::fired = 0;
+  TestStaticNet net;
+  SharedTreePointer<Token> token(new StaticToken(2));
+
+  // Needs two anonymous tokens as well
+  net.addToken<1>(token);
+  net.addTokens<4>(1);
+  BOOST_TEST(!net.canFire<1>(token));
+  net.addTokens<4>(1);
+  BOOST_TEST(net.canFire<1>(token));
+
+  // The children of the token go to the place at their level
+  net.fire<1>(token);
+  BOOST_TEST(StaticToken::fired == 1);
+  BOOST_TEST(net.tokenCount<1>() == 0);
+  BOOST_TEST(net.tokenCount<4>() == 0);
+  BOOST_TEST(net.count<2>(token) == 1);
+  BOOST_TEST(net.tokenCount<3>() == 2);
+  BOOST_TEST(net.count<3>(token.child(1)) == 1);
+
+  BOOST_TEST(net.canFire<2>(token));
+  net.fire<2>(token);
+  BOOST_TEST(net.tokenCount<2>() == 0);
+  BOOST_TEST(net.tokenCount<5>() == 3);
+
+  // The counter place has no room for another fire
+  net.addToken<2>(token);
+  BOOST_TEST(!net.canFire<2>(token));
+}
+
+BOOST_AUTO_TEST_CASE(testStaticNetReleasesTokens)
+{
+  TestStaticNet net;
+  SharedTreePointer<Token> token1(new StaticToken());
+  SharedTreePointer<Token> token2(new StaticToken());
+  net.addToken<2>(token1);
+  net.addToken<2>(token2);
+  BOOST_TEST(token1.use_count() == 2);
+
+  // Output capacity is counted in tokens
+  BOOST_TEST(!net.canFire<1>(token1));
+
+  net.fire<2>(token1);
+  BOOST_TEST(token1.use_count() == 1);
+  BOOST_TEST(net.count<2>(token2) == 1);
+  BOOST_TEST(net.count<2>(token1) == 0);
+}
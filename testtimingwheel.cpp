@@ -0,0 +1,100 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <boost/test/unit_test.hpp>
+#include "timingwheel.h"
+#include "workerpool.h"
+
+using namespace petrinet;
+
+BOOST_AUTO_TEST_CASE(testTimingWheelLevels)
+{
+  // Microsecond ticks, the delays reach the third level of the wheel
+  WorkerPool thread(1);
+  TimingWheel wheel(thread.get(), std::chrono::microseconds(1));
+
+  const std::chrono::microseconds delays[] = {
+    std::chrono::microseconds(0),
+    std::chrono::microseconds(100),
+    std::chrono::microseconds(5000),
+    std::chrono::microseconds(70000),
+    std::chrono::microseconds(120000) };
+
+  std::atomic<int> expired(0);
+  std::atomic<int> early(0);
+  std::promise<void> done;
+  auto start = TimingWheel::Clock::now();
+  for(int i = 0; i < 5; ++i)
+  {
+    std::chrono::microseconds delay = delays[i];
+    wheel.add(delay, [&, delay]
+    {
+      if(TimingWheel::Clock::now() - start < delay)
+        ++early;
+      if(++expired == 5)
+        done.set_value();
+    });
+  }
+
+  done.get_future().wait();
+
+  BOOST_TEST(expired == 5);
+  BOOST_TEST(early == 0);
+}
+
+BOOST_AUTO_TEST_CASE(testTimingWheelEarlierTimer)
+{
+  // The wheel sleeps until the far timer, the near one has to re-arm it
+  WorkerPool thread(1);
+  TimingWheel wheel(thread.get());
+
+  std::promise<void> done;
+  wheel.add(std::chrono::hours(1), []{});
+  wheel.add(std::chrono::milliseconds(300), []{});
+  wheel.add(std::chrono::milliseconds(10), [&]{ done.set_value(); });
+
+  BOOST_TEST((done.get_future().wait_for(std::chrono::seconds(10)) == std::future_status::ready));
+
+  std::promise<int> cleared;
+  thread.get().post([&]{ cleared.set_value(wheel.clear()); });
+  BOOST_TEST(cleared.get_future().get() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(testTimingWheelClear)
+{
+  WorkerPool thread(1);
+  TimingWheel wheel(thread.get());
+
+  std::atomic<int> expired(0);
+  for(int i = 0; i < 1000; ++i)
+    wheel.add(std::chrono::hours(1), [&]{ ++expired; });
+
+  std::promise<int> cleared;
+  thread.get().post([&]{ cleared.set_value(wheel.clear()); });
+
+  BOOST_TEST(cleared.get_future().get() == 1000);
+  BOOST_TEST(expired == 0);
+}
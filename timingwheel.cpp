@@ -0,0 +1,156 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+#include "timingwheel.h"
+
+using namespace petrinet;
+
+TimingWheel::TimingWheel(boost::asio::io_service& ioService, Clock::duration tick)
+  : ioService_(ioService),
+  timer_(ioService),
+  tick_(tick),
+  start_(Clock::now()),
+  now_(0),
+  armed_(0),
+  count_(0)
+{
+}
+
+void TimingWheel::add(Clock::duration delay, const std::function<void()>& callback)
+{
+  // The delay starts now, not when the io_service gets to the insert
+  unsigned long long expiry = (Clock::now() - start_ + delay + tick_ - Clock::duration(1)) / tick_;
+  ioService_.post([this, expiry, callback]
+  {
+    // Idle, nothing is lost by skipping the ticks that passed
+    if(count_ == 0)
+      now_ = std::max(now_, (unsigned long long)((Clock::now() - start_) / tick_));
+
+    unsigned long long tick = insert(Timer{expiry, callback});
+    if(++count_ == 1 || tick < armed_)
+      arm(tick);
+  });
+}
+
+int TimingWheel::clear()
+{
+  int count = count_;
+  for(int level = 0; level < levelCount; ++level)
+  {
+    for(int slot = 0; slot < slotCount; ++slot)
+      slots_[level][slot].clear();
+  }
+  count_ = 0;
+  timer_.cancel();
+  return count;
+}
+
+unsigned long long TimingWheel::insert(const Timer& timer)
+{
+  unsigned long long expiry = std::max(timer.expiry, now_ + 1);
+
+  // Lowest level on which the expiry is within the current turn
+  int level = 0;
+  while(level < levelCount - 1 && (expiry >> (levelBits * (level + 1))) != (now_ >> (levelBits * (level + 1))))
+    ++level;
+
+  int slot = (expiry >> (levelBits * level)) & (slotCount - 1);
+  slots_[level][slot].push_back(Timer{expiry, timer.callback});
+  return (expiry >> (levelBits * level)) << (levelBits * level);
+}
+
+void TimingWheel::cascade(int level)
+{
+  std::vector<Timer> timers;
+  timers.swap(slots_[level][(now_ >> (levelBits * level)) & (slotCount - 1)]);
+  for(auto it = timers.begin(); it != timers.end(); ++it)
+    insert(*it);
+}
+
+void TimingWheel::advance()
+{
+  ++now_;
+
+  // A turn of a level completed, move the next slot of the level above down
+  for(int level = 1; level < levelCount && (now_ & ((1ull << (levelBits * level)) - 1)) == 0; ++level)
+    cascade(level);
+
+  std::vector<Timer> expired;
+  expired.swap(slots_[0][now_ & (slotCount - 1)]);
+  count_ -= expired.size();
+  for(auto it = expired.begin(); it != expired.end(); ++it)
+    it->callback();
+}
+
+unsigned long long TimingWheel::nextTick() const
+{
+  // The slots of a level below the current one are handled already. The
+  // first non-empty slot of the lowest level comes before any slot of the
+  // levels above, which are only handled at their cascade boundaries.
+  for(int level = 0; level < levelCount - 1; ++level)
+  {
+    int shift = levelBits * level;
+    unsigned long long turn = (now_ >> (shift + levelBits)) << (shift + levelBits);
+    for(int slot = ((now_ >> shift) & (slotCount - 1)) + 1; slot < slotCount; ++slot)
+    {
+      if(!slots_[level][slot].empty())
+        return turn | ((unsigned long long)slot << shift);
+    }
+  }
+
+  // The top level wraps around, its timers may lie turns ahead
+  int shift = levelBits * (levelCount - 1);
+  for(int distance = 1; distance <= slotCount; ++distance)
+  {
+    if(!slots_[levelCount - 1][((now_ >> shift) + distance) & (slotCount - 1)].empty())
+      return ((now_ >> shift) + distance) << shift;
+  }
+  return now_ + 1;
+}
+
+void TimingWheel::arm(unsigned long long tick)
+{
+  armed_ = tick;
+  timer_.expires_at(start_ + tick_ * tick);
+  timer_.async_wait(std::bind(&TimingWheel::handleTick, this, std::placeholders::_1));
+}
+
+void TimingWheel::handleTick(const boost::system::error_code& error)
+{
+  if(error)
+    return;
+
+  // Jump to the ticks that have work up to now, the skipped ones are empty
+  unsigned long long target = (Clock::now() - start_) / tick_;
+  while(count_ > 0)
+  {
+    unsigned long long next = nextTick();
+    if(next > target)
+      break;
+    now_ = next - 1;
+    advance();
+  }
+
+  if(count_ > 0)
+    arm(nextTick());
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+#ifndef PETRINET_TIMINGWHEEL_H
+#define PETRINET_TIMINGWHEEL_H
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+namespace petrinet
+{
+
+  // Hierarchical timing wheel driven by a timer of an io_service. Four levels
+  // of 256 slots, each slot of a level spans a full turn of the level below.
+  // Adding and expiring a timer is O(1), a timer moves down at most three
+  // times before it expires.
+  class TimingWheel
+  {
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    TimingWheel(boost::asio::io_service& ioService, Clock::duration tick = std::chrono::milliseconds(1));
+
+    // Safe to call from any thread, the callback runs on the io_service
+    void add(Clock::duration delay, const std::function<void()>& callback);
+
+    // On the io_service only. Drops all timers, returns how many there were.
+    int clear();
+
+  private:
+    struct Timer
+    {
+      unsigned long long expiry;
+      std::function<void()> callback;
+    };
+
+    static const int levelBits = 8;
+    static const int slotCount = 1 << levelBits;
+    static const int levelCount = 4;
+
+    // Returns the tick on which the wheel next handles the slot of the timer
+    unsigned long long insert(const Timer& timer);
+    void cascade(int level);
+    void advance();
+    unsigned long long nextTick() const;
+    void arm(unsigned long long tick);
+    void handleTick(const boost::system::error_code& error);
+
+    boost::asio::io_service& ioService_;
+    boost::asio::steady_timer timer_;
+    Clock::duration tick_;
+    Clock::time_point start_;
+
+    // Last tick that was processed
+    unsigned long long now_;
+    // Tick the timer is armed for
+    unsigned long long armed_;
+    std::vector<Timer> slots_[levelCount][slotCount];
+    int count_;
+  };
+}
+
+#endif
\ No newline at end of file
@@ -45,6 +45,17 @@ Token* Token::child(int i) const
   return 0;
 }
 
+int Token::descendants(int depth) const
+{
+  if(depth == 0)
+    return 1;
+
+  int n = 0;
+  for(int i = 0; i < size(); ++i)
+    n += child(i)->descendants(depth - 1);
+  return n;
+}
+
 std::string Token::toString() const
 {
   return "<Token>";
@@ -29,12 +29,14 @@
 #include <unordered_map>
 #include <vector>
 
+#include "refcounted.h"
 #include "sharedtreepointer.h"
 
 namespace petrinet
 {
 
-  class Token
+  // Trees of tokens count their references in the root token
+  class Token : public RefCounted
   {
   public:
     Token();
@@ -42,6 +44,9 @@ namespace petrinet
 
     virtual int size() const;
     virtual Token* child(int i) const;
+    // Number of tokens depth levels below this one, walks the tree unless
+    // the token keeps the counts
+    virtual int descendants(int depth) const;
     virtual std::string toString() const;
   };
 }
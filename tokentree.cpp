@@ -0,0 +1,154 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+#include <algorithm>
+#include <cstdint>
+
+#include "tokentree.h"
+
+using namespace petrinet;
+
+TreeToken::TreeToken()
+  : arena_(nullptr),
+  index_(-1),
+  first_(0),
+  size_(0),
+  children_(nullptr),
+  height_(1),
+  counts_(nullptr)
+{
+}
+
+void TreeToken::destroy() const
+{
+  assert(arena_);
+  delete arena_;
+}
+
+TokenArena::TokenArena(int blockSize)
+  : tokens(nullptr),
+  size(0),
+  blocks(nullptr),
+  next(nullptr),
+  end(nullptr),
+  blockSize(blockSize)
+{
+}
+
+TokenArena::~TokenArena()
+{
+  // Children go before their parents
+  for(int i = size - 1; i >= 0; --i)
+    tokens[i]->~Token();
+
+  while(blocks)
+  {
+    char* previous = *reinterpret_cast<char**>(blocks);
+    delete[] blocks;
+    blocks = previous;
+  }
+}
+
+void* TokenArena::allocate(std::size_t size, std::size_t alignment)
+{
+  std::size_t padding = (alignment - reinterpret_cast<std::uintptr_t>(next) % alignment) % alignment;
+  if(!next || next + padding + size > end)
+  {
+    // Larger tokens than a block get a block of their own
+    std::size_t bytes = std::max<std::size_t>(blockSize, sizeof(char*) + size + alignment);
+    char* block = new char[bytes];
+    *reinterpret_cast<char**>(block) = blocks;
+    blocks = block;
+    next = block + sizeof(char*);
+    end = block + bytes;
+    padding = (alignment - reinterpret_cast<std::uintptr_t>(next) % alignment) % alignment;
+  }
+
+  void* p = next + padding;
+  next += padding + size;
+  return p;
+}
+
+TokenTreeBuilder::TokenTreeBuilder(int blockSize)
+  : arena_(new TokenArena(blockSize)),
+  blockSize_(blockSize),
+  lastParent_(0)
+{
+}
+
+TokenTreeBuilder::~TokenTreeBuilder()
+{
+  // Tokens of a tree never built
+  for(auto it = tokens_.rbegin(); it != tokens_.rend(); ++it)
+    (*it)->~TreeToken();
+}
+
+SharedTreePointer<Token> TokenTreeBuilder::build()
+{
+  assert(!tokens_.empty());
+
+  // The children of a token are consecutive in level order, a single table
+  // in the arena holds them all
+  const std::vector<TreeToken*>& tokens = tokens_;
+  arena_->size = tokens.size();
+  arena_->tokens = static_cast<Token**>(arena_->allocate(tokens.size() * sizeof(Token*), std::alignment_of<Token*>::value));
+  std::copy(tokens.begin(), tokens.end(), arena_->tokens);
+  for(auto it = tokens.begin(); it != tokens.end(); ++it)
+    (*it)->children_ = arena_->tokens + (*it)->first_;
+
+  // Children come after their parents, bottom up the heights are known
+  // before the parent needs them
+  std::size_t total = 0;
+  for(auto it = tokens.rbegin(); it != tokens.rend(); ++it)
+  {
+    TreeToken* token = *it;
+    for(int i = 0; i < token->size_; ++i)
+      token->height_ = std::max(token->height_, tokens[token->first_ + i]->height_ + 1);
+    total += token->height_;
+  }
+
+  int* counts = static_cast<int*>(arena_->allocate(total * sizeof(int), std::alignment_of<int>::value));
+  std::fill(counts, counts + total, 0);
+  for(auto it = tokens.rbegin(); it != tokens.rend(); ++it)
+  {
+    TreeToken* token = *it;
+    total -= token->height_;
+    int* level = counts + total;
+    level[0] = 1;
+    for(int i = 0; i < token->size_; ++i)
+    {
+      const TreeToken* child = tokens[token->first_ + i];
+      for(int depth = 0; depth < child->height_; ++depth)
+        level[depth + 1] += child->counts_[depth];
+    }
+    token->counts_ = level;
+  }
+
+  // The root owns the arena, released with the last reference to the tree
+  TreeToken* root = tokens.front();
+  root->arena_ = arena_.release();
+  arena_.reset(new TokenArena(blockSize_));
+  lastParent_ = 0;
+  tokens_.clear();
+  return SharedTreePointer<Token>(root);
+}
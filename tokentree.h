@@ -0,0 +1,157 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+#ifndef PETRINET_TOKENTREE_H
+#define PETRINET_TOKENTREE_H
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "sharedtreepointer.h"
+#include "token.h"
+
+namespace petrinet
+{
+
+  class TokenTreeBuilder;
+  struct TokenArena;
+
+  // Token of a tree laid out by a TokenTreeBuilder. The tokens of a tree are
+  // stored one level after the other in a single arena, which is released
+  // at once when the last pointer into the tree goes.
+  class TreeToken : public Token
+  {
+  public:
+    TreeToken();
+
+    virtual int size() const { return size_; }
+    virtual Token* child(int i) const { assert(i < size_); return children_[i]; }
+    // Counted when the tree is built
+    virtual int descendants(int depth) const { return depth < height_ ? counts_[depth] : 0; }
+
+  protected:
+    // The root releases the arena, and with it the tree
+    virtual void destroy() const;
+
+  private:
+    friend class TokenTreeBuilder;
+
+    TokenArena* arena_;
+    // Position in the level order of the tree, and the first of its children
+    int index_;
+    int first_;
+    int size_;
+    Token* const* children_;
+    // Levels in the subtree of the token, and the number of tokens on each
+    int height_;
+    const int* counts_;
+  };
+
+  // Owns the tokens of a built tree, and the tables pointing into it
+  struct TokenArena
+  {
+    TokenArena(int blockSize);
+    ~TokenArena();
+
+    void* allocate(std::size_t size, std::size_t alignment);
+
+    // Level order, also the table of children of the tokens
+    Token** tokens;
+    int size;
+    // Last block, each block starts with a pointer to the one before it
+    char* blocks;
+    char* next;
+    char* end;
+    int blockSize;
+  };
+
+  // Builds a token tree in level order: the root, then the children of each
+  // token in the order the tokens were created. That is the order the tree
+  // is traversed in, and the order the tokens are laid out in memory.
+  class TokenTreeBuilder
+  {
+  public:
+    // Once the builder built a tree as large, a tree fitting in a block
+    // takes two allocations: the arena and its block
+    explicit TokenTreeBuilder(int blockSize = 4096);
+    ~TokenTreeBuilder();
+
+    template<class T, typename... Args>
+    T* root(Args&&... args);
+    // All children of a token are added before those of a later one
+    template<class T, typename... Args>
+    T* child(TreeToken* parent, Args&&... args);
+
+    // The builder starts over, the tree lives as long as pointers into it
+    SharedTreePointer<Token> build();
+
+  private:
+    template<class T, typename... Args>
+    T* create(Args&&... args);
+
+    std::unique_ptr<TokenArena> arena_;
+    int blockSize_;
+    int lastParent_;
+    // Tokens of the tree being built in level order, reused by the next
+    std::vector<TreeToken*> tokens_;
+  };
+
+  template<class T, typename... Args>
+  T* TokenTreeBuilder::root(Args&&... args)
+  {
+    assert(tokens_.empty());
+    return create<T>(std::forward<Args>(args)...);
+  }
+
+  template<class T, typename... Args>
+  T* TokenTreeBuilder::child(TreeToken* parent, Args&&... args)
+  {
+    // Level order keeps the children of a token next to each other
+    assert(parent->index_ >= lastParent_);
+    assert(parent->size_ == 0 || parent->first_ + parent->size_ == (int)tokens_.size());
+    lastParent_ = parent->index_;
+
+    if(parent->size_ == 0)
+      parent->first_ = tokens_.size();
+    ++parent->size_;
+    return create<T>(std::forward<Args>(args)...);
+  }
+
+  template<class T, typename... Args>
+  T* TokenTreeBuilder::create(Args&&... args)
+  {
+    static_assert(std::is_base_of<TreeToken, T>::value, "tokens of a tree derive from TreeToken");
+
+    T* token = new(arena_->allocate(sizeof(T), std::alignment_of<T>::value)) T(std::forward<Args>(args)...);
+    token->index_ = tokens_.size();
+    tokens_.push_back(token);
+    return token;
+  }
+}
+
+#endif
\ No newline at end of file
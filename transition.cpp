@@ -21,6 +21,7 @@
  * THE SOFTWARE.
  **/
 
+#include <algorithm>
 #include <cassert>
 
 #include "transition.h"
@@ -28,43 +29,65 @@
 using namespace petrinet;
 
 
-Transition::Transition(const std::list<int>& inputPlaces, const std::list<int>& outputPlaces, std::function<void(Token*, boost::any, boost::any, boost::any)> func)
-  : inputPlaces_(inputPlaces),
-  outputPlaces_(outputPlaces),
-  func_(func)
+Arcs::Arcs(std::initializer_list<int> places)
 {
-  for(auto it = inputPlaces_.begin(); it != inputPlaces_.end(); ++it)
-  {
-    if(inputPlacesCount_.find(*it) != inputPlacesCount_.end())
-      ++inputPlacesCount_[*it];
-    else
-      inputPlacesCount_.insert(std::pair<int, int>(*it, 1));
-  }
+  for(auto it = places.begin(); it != places.end(); ++it)
+    add(*it, 1);
+}
 
-  for(auto it = outputPlaces_.begin(); it != outputPlaces_.end(); ++it)
-  {
-    if(outputPlacesCount_.find(*it) != outputPlacesCount_.end())
-      ++outputPlacesCount_[*it];
-    else
-      outputPlacesCount_.insert(std::pair<int, int>(*it, 1));
-  }
+Arcs::Arcs(const std::list<int>& places)
+{
+  for(auto it = places.begin(); it != places.end(); ++it)
+    add(*it, 1);
 }
 
+Arcs::Arcs(std::initializer_list<Arc> arcs)
+{
+  for(auto it = arcs.begin(); it != arcs.end(); ++it)
+    add(it->place, it->weight);
+}
 
-Transition::~Transition()
+void Arcs::add(int place, int weight)
 {
+  assert(weight > 0);
+  auto it = std::find_if(arcs_.begin(), arcs_.end(), [=](const Arc& a){ return a.place == place; });
+  if(it != arcs_.end())
+    it->weight += weight;
+  else
+    arcs_.push_back(Arc{place, weight});
 }
 
-int Transition::requiredTokens(int placeId) const
+Transition::Transition(const Arcs& inputs, const Arcs& outputs, std::function<void(Token*, boost::any, boost::any, boost::any)> func)
+  : inputs_(inputs),
+  outputs_(outputs),
+  func_(func),
+  delay_(0),
+  queueLimit_(-1),
+  join_(false),
+  inputArcCount_(0)
 {
-  assert(inputPlacesCount_.find(placeId) != inputPlacesCount_.end());
-  return inputPlacesCount_.find(placeId)->second;
 }
 
-int Transition::requiredCapacity(int placeId) const
+
+Transition::~Transition()
 {
-  assert(outputPlacesCount_.find(placeId) != outputPlacesCount_.end());
-  return outputPlacesCount_.find(placeId)->second;
 }
 
+void Transition::compile(const std::unordered_map<int, int>& placeIndices)
+{
+  arcs_.clear();
 
+  for(auto it = inputs_.begin(); it != inputs_.end(); ++it)
+  {
+    assert(placeIndices.find(it->place) != placeIndices.end());
+    arcs_.push_back(Arc{placeIndices.find(it->place)->second, it->weight});
+  }
+
+  inputArcCount_ = arcs_.size();
+
+  for(auto it = outputs_.begin(); it != outputs_.end(); ++it)
+  {
+    assert(placeIndices.find(it->place) != placeIndices.end());
+    arcs_.push_back(Arc{placeIndices.find(it->place)->second, it->weight});
+  }
+}
\ No newline at end of file
@@ -25,10 +25,14 @@
 #define PETRINET_TRANSITION_H
 
 #include <boost/any.hpp>
+#include <chrono>
 #include <functional>
+#include <initializer_list>
 #include <list>
 #include <unordered_map>
+#include <vector>
 
+#include "action.h"
 #include "sharedtreepointer.h"
 
 namespace petrinet
@@ -36,26 +40,85 @@ namespace petrinet
 
   class Token;
 
+  // Place and the number of tokens taken from or put in it. Given by place id,
+  // a compiled transition has the dense index of the place in the net.
+  struct Arc
+  {
+    int place;
+    int weight;
+  };
+
+  // Arcs on one side of a transition, a place listed more than once is a
+  // single arc weighing the number of times: {1, 1, 2} is {Arc{1, 2}, Arc{2, 1}}
+  class Arcs
+  {
+  public:
+    Arcs() {}
+    Arcs(std::initializer_list<int> places);
+    Arcs(const std::list<int>& places);
+    Arcs(std::initializer_list<Arc> arcs);
+
+    const Arc* begin() const { return arcs_.data(); }
+    const Arc* end()   const { return arcs_.data() + arcs_.size(); }
+    int size() const { return arcs_.size(); }
+
+  private:
+    void add(int place, int weight);
+
+    std::vector<Arc> arcs_;
+  };
+
+  // Tokens bound by a join transition, one per input place in their order
+  typedef std::vector<SharedTreePointer<Token>> JoinBindings;
+
   class Transition
   {
   public:
-    Transition(const std::list<int>& inputPlaces, const std::list<int>& outputPlaces, std::function<void(Token*, boost::any, boost::any, boost::any)> func);
+    Transition(const Arcs& inputs, const Arcs& outputs, std::function<void(Token*, boost::any, boost::any, boost::any)> func);
     virtual ~Transition();
 
-    std::list<int>              inputPlaces()    const { return inputPlaces_; }
-    std::list<int>              outputPlaces()   const { return outputPlaces_; }
-    std::function<void(Token*, boost::any, boost::any, boost::any)> func() const { return func_; }
+    // By place id
+    const Arcs&                 inputs()         const { return inputs_; }
+    const Arcs&                 outputs()        const { return outputs_; }
+    const std::function<void(Token*, boost::any, boost::any, boost::any)>& func() const { return func_; }
+
+    // Typed action, used instead of func
+    const std::shared_ptr<const TransitionAction>& action() const { return action_; }
+    void setAction(const std::shared_ptr<const TransitionAction>& action) { action_ = action; }
+
+    // Fires of a timed transition are only queued once the delay passed
+    std::chrono::milliseconds delay() const { return delay_; }
+    void setDelay(std::chrono::milliseconds delay) { delay_ = delay; }
+
+    // Most fires waiting for the transition, -1 is no limit
+    int queueLimit() const { return queueLimit_; }
+    void setQueueLimit(int limit) { queueLimit_ = limit; }
+
+    // Fires by itself for tokens with the same key in all its keyed input
+    // places, instead of for queued fires
+    bool join() const { return join_; }
+    void setJoin(bool join) { join_ = join; }
+
+    // Resolves the place ids of the arcs to dense place indices
+    void compile(const std::unordered_map<int, int>& placeIndices);
 
-    int requiredTokens  (int placeId) const;
-    int requiredCapacity(int placeId) const;
+    const Arc* inputArcsBegin()  const { return arcs_.data(); }
+    const Arc* inputArcsEnd()    const { return arcs_.data() + inputArcCount_; }
+    const Arc* outputArcsBegin() const { return arcs_.data() + inputArcCount_; }
+    const Arc* outputArcsEnd()   const { return arcs_.data() + arcs_.size(); }
 
   private:
-    std::list<int> inputPlaces_;
-    std::list<int> outputPlaces_;
+    Arcs inputs_;
+    Arcs outputs_;
     std::function<void(Token*, boost::any, boost::any, boost::any)> func_;
+    std::shared_ptr<const TransitionAction> action_;
+    std::chrono::milliseconds delay_;
+    int queueLimit_;
+    bool join_;
 
-    std::unordered_map<int, int> inputPlacesCount_;
-    std::unordered_map<int, int> outputPlacesCount_;
+    // Input arcs followed by output arcs
+    std::vector<Arc> arcs_;
+    int inputArcCount_;
   };
 
 }
@@ -0,0 +1,73 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+#include "workerpool.h"
+
+using namespace petrinet;
+
+WorkerPool::WorkerPool(int threads)
+  : work_(new boost::asio::io_service::work(ioService_)),
+  size_(threads)
+{
+  for(int i = 0; i < threads; ++i)
+    threads_.create_thread([this]{ ioService_.run(); });
+}
+
+WorkerPool::~WorkerPool()
+{
+  work_.reset();
+  threads_.join_all();
+}
+
+int WorkerPool::size() const
+{
+  return size_;
+}
+
+boost::asio::io_service& WorkerPool::get()
+{
+  return ioService_;
+}
+
+void WorkerPool::runAll(const std::vector<std::function<void()>>& tasks)
+{
+  std::mutex mutex;
+  std::condition_variable cv;
+  int remaining = tasks.size();
+
+  for(auto it = tasks.begin(); it != tasks.end(); ++it)
+  {
+    std::function<void()> task = *it;
+    ioService_.post([&, task]
+    {
+      task();
+
+      std::unique_lock<std::mutex> lk(mutex);
+      if(--remaining == 0)
+        cv.notify_all();
+    });
+  }
+
+  std::unique_lock<std::mutex> lk(mutex);
+  cv.wait(lk, [&]{ return remaining == 0; });
+}
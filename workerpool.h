@@ -0,0 +1,60 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+#ifndef PETRINET_WORKERPOOL_H
+#define PETRINET_WORKERPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+
+namespace petrinet
+{
+
+  // Fixed set of threads running the handlers posted to one io_service
+  class WorkerPool
+  {
+  public:
+    WorkerPool(int threads);
+    ~WorkerPool();
+
+    int size() const;
+    boost::asio::io_service& get();
+
+    // Runs the tasks on the pool and returns when all of them finished
+    void runAll(const std::vector<std::function<void()>>& tasks);
+
+  private:
+    boost::asio::io_service ioService_;
+    std::unique_ptr<boost::asio::io_service::work> work_;
+    boost::thread_group threads_;
+    int size_;
+  };
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,50 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+#include "worklist.h"
+
+using namespace petrinet;
+
+std::size_t FireCandidateHash::operator()(const std::pair<int, Token*>& c) const
+{
+  return hashPointer(c.second) ^ (std::size_t) c.first * 2654435761u;
+}
+
+Worklist::Worklist()
+  : queued_(std::pair<int, Token*>(-1, nullptr))
+{
+}
+
+void Worklist::push(const FireCandidate& candidate)
+{
+  if(queued_.insert(std::pair<int, Token*>(candidate.transition, candidate.token.get()), true).second)
+    candidates_.push_back(candidate);
+}
+
+FireCandidate Worklist::pop()
+{
+  FireCandidate candidate = candidates_.front();
+  candidates_.pop_front();
+  queued_.erase(std::pair<int, Token*>(candidate.transition, candidate.token.get()));
+  return candidate;
+}
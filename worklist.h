@@ -0,0 +1,69 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Pieter Verberck
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ **/
+
+#ifndef PETRINET_WORKLIST_H
+#define PETRINET_WORKLIST_H
+
+#include <utility>
+
+#include "flatmap.h"
+#include "ringbuffer.h"
+#include "sharedtreepointer.h"
+#include "token.h"
+
+namespace petrinet
+{
+
+  // Fire that might have become possible, an empty token means any queued fire will do
+  struct FireCandidate
+  {
+    bool operator==(const FireCandidate& c) const { return transition == c.transition && token == c.token; }
+
+    int transition;
+    SharedTreePointer<Token> token;
+  };
+
+  struct FireCandidateHash
+  {
+    std::size_t operator()(const std::pair<int, Token*>& c) const;
+  };
+
+  // FIFO of fire candidates, a candidate already waiting in the list is not
+  // added a second time
+  class Worklist
+  {
+  public:
+    Worklist();
+
+    bool empty() const { return candidates_.empty(); }
+    void push(const FireCandidate& candidate);
+    FireCandidate pop();
+
+  private:
+    RingBuffer<FireCandidate> candidates_;
+    // Transition and token of the waiting candidates
+    FlatMap<std::pair<int, Token*>, bool, FireCandidateHash> queued_;
+  };
+}
+
+#endif
\ No newline at end of file